@@ -0,0 +1,348 @@
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "builder.hpp"
+#include "chash.hpp"
+
+namespace
+{
+
+using Updater = chash::WeightUpdater;
+using RealId = Updater::RealId;
+using Weight = Updater::Weight;
+using chash::CountingResource;
+
+constexpr std::size_t MAX_LOOKUP = 1u << 26;
+constexpr Weight MAX_WEIGHT = chash::DefaultConfig::MaxWeight;
+
+struct Service
+{
+	std::vector<std::string> reals;
+	std::vector<RealId> ids;
+	std::vector<Weight> weights;
+	std::size_t mappings;
+	std::size_t cells;
+	std::size_t lookup_size;
+
+	Service(std::size_t count, std::size_t mappings_, std::size_t cells_, std::size_t factor = 1) :
+	        mappings{mappings_},
+	        cells{cells_},
+	        lookup_size{Updater::LookupRequiredSize(count, cells_) * factor}
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			reals.push_back("2a02:6b8:0:" + std::to_string(i) + "::1");
+			ids.push_back(i + 1);
+			weights.push_back(MAX_WEIGHT);
+		}
+	}
+
+	std::optional<Updater> Make(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const
+	{
+		return Updater::MakeWeightUpdater(
+		        reals.data(), ids.data(), weights.data(), ids.size(), mappings, cells, lookup_size, resource);
+	}
+};
+
+// updaters are expensive to build, benchmarks of the same service share one;
+// null if the build failed, \state is skipped then
+const Updater* Cached(benchmark::State& state, const Service& service)
+{
+	static std::map<std::tuple<std::size_t, std::size_t, std::size_t, std::size_t>, std::unique_ptr<Updater>> cache;
+	auto& updater = cache[{service.ids.size(), service.mappings, service.cells, service.lookup_size}];
+	if (!updater)
+	{
+		auto made = service.Make();
+		if (!made)
+		{
+			state.SkipWithError("failed to make updater");
+			return nullptr;
+		}
+		updater = std::make_unique<Updater>(std::move(made.value()));
+	}
+	return updater.get();
+}
+
+std::vector<RealId> Lookup(const Updater& updater)
+{
+	std::vector<RealId> lookup(updater.LookupSize());
+	updater.InitLookup(lookup.data());
+	return lookup;
+}
+
+// reals x mappings x cells, skipping lookups too big for a benchmark host
+void Services(benchmark::internal::Benchmark* b)
+{
+	for (std::int64_t reals : {10, 100, 1000, 10000, 100000})
+	{
+		for (std::int64_t cells : {1, 20})
+		{
+			if (static_cast<std::size_t>(reals * cells) * MAX_WEIGHT <= MAX_LOOKUP)
+			{
+				b->Args({reals, 100, cells});
+			}
+		}
+	}
+	b->Args({1000, 10, 20});
+	b->Args({1000, 1000, 20});
+	b->ArgNames({"reals", "mappings", "cells"});
+}
+
+// reals x cells x lookup factor, skipping lookups too big for a benchmark host
+void Lookups(benchmark::internal::Benchmark* b)
+{
+	for (std::int64_t reals : {10, 1000, 100000})
+	{
+		for (std::int64_t cells : {1, 20})
+		{
+			for (std::int64_t factor : {1, 2})
+			{
+				if (static_cast<std::size_t>(reals * cells * factor) * MAX_WEIGHT <= MAX_LOOKUP)
+				{
+					b->Args({reals, cells, factor});
+				}
+			}
+		}
+	}
+	b->ArgNames({"reals", "cells", "lookup_factor"});
+}
+
+// the library allocates through std::pmr only, so counting the resource
+// given to it counts every allocation of construction
+void SetAllocations(benchmark::State& state, const CountingResource& resource, std::size_t before)
+{
+	state.counters["allocations"] =
+	        benchmark::Counter(resource.allocations - before, benchmark::Counter::kAvgIterations);
+}
+
+void BM_MakeWeightUpdater(benchmark::State& state)
+{
+	Service service(state.range(0), state.range(1), state.range(2));
+	CountingResource resource;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(service.Make(&resource));
+	}
+	SetAllocations(state, resource, 0);
+	state.SetItemsProcessed(state.iterations() * service.ids.size());
+}
+BENCHMARK(BM_MakeWeightUpdater)->Apply(Services)->Unit(benchmark::kMillisecond);
+
+// side rings big enough for 100k reals, default ones leave some of them out;
+// not a power of two, so that collisions of reals differ between salts
+struct ScalingConfig : chash::DefaultConfig
+{
+	static constexpr std::size_t DEFAULT_UNWEIGHTED_SIZE = 655357;
+};
+
+// construction time against real count, rings cost the same for any count
+void BM_Scaling(benchmark::State& state)
+{
+	using ScalingUpdater = chash::BasicWeightUpdater<ScalingConfig>;
+	Service service(state.range(0), 20, 1);
+	for (auto _ : state)
+	{
+		auto updater = ScalingUpdater::MakeWeightUpdater(service.reals.data(),
+		                                                 service.ids.data(),
+		                                                 service.weights.data(),
+		                                                 service.ids.size(),
+		                                                 service.mappings,
+		                                                 service.cells,
+		                                                 service.lookup_size);
+		if (!updater)
+		{
+			state.SkipWithError("failed to make updater");
+			break;
+		}
+		benchmark::DoNotOptimize(updater);
+	}
+	state.SetComplexityN(state.range(0));
+	state.SetItemsProcessed(state.iterations() * service.ids.size());
+}
+BENCHMARK(BM_Scaling)
+        ->RangeMultiplier(10)
+        ->Range(10, 100000)
+        ->ArgName("reals")
+        ->Complexity(benchmark::oN)
+        ->Unit(benchmark::kMillisecond);
+
+void BM_Builder(benchmark::State& state)
+{
+	Service service(state.range(0), state.range(1), state.range(2));
+	CountingResource resource;
+	chash::UpdaterBuilder builder(&resource);
+	auto make = [&]() {
+		return builder.MakeWeightUpdater(service.reals.data(),
+		                                 service.ids.data(),
+		                                 service.weights.data(),
+		                                 service.ids.size(),
+		                                 service.mappings,
+		                                 service.cells,
+		                                 service.lookup_size,
+		                                 &resource);
+	};
+	benchmark::DoNotOptimize(make());
+	std::size_t before = resource.allocations;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(make());
+	}
+	SetAllocations(state, resource, before);
+	state.SetItemsProcessed(state.iterations() * service.ids.size());
+}
+BENCHMARK(BM_Builder)->Apply(Services)->Unit(benchmark::kMillisecond);
+
+void BM_InitLookup(benchmark::State& state)
+{
+	Service service(state.range(0), 100, state.range(1), state.range(2));
+	const auto* updater = Cached(state, service);
+	if (!updater)
+	{
+		return;
+	}
+	std::vector<RealId> lookup(updater->LookupSize());
+	for (auto _ : state)
+	{
+		updater->InitLookup(lookup.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * lookup.size() * sizeof(RealId));
+}
+BENCHMARK(BM_InitLookup)
+        ->Apply(Lookups)
+        ->Unit(benchmark::kMicrosecond);
+
+// one real drained and restored, two UpdateWeight calls per iteration
+void BM_UpdateWeightSingle(benchmark::State& state)
+{
+	Service service(state.range(0), 100, state.range(1), state.range(2));
+	const auto* cached = Cached(state, service);
+	if (!cached)
+	{
+		return;
+	}
+	Updater updater = *cached;
+	auto lookup = Lookup(updater);
+	RealId id = service.ids[service.ids.size() / 2];
+	for (auto _ : state)
+	{
+		updater.UpdateWeight(id, 0, lookup.data());
+		updater.UpdateWeight(id, MAX_WEIGHT, lookup.data());
+	}
+}
+BENCHMARK(BM_UpdateWeightSingle)
+        ->Apply(Lookups);
+
+// every real drained one by one and restored
+void BM_UpdateWeightDrain(benchmark::State& state)
+{
+	Service service(state.range(0), 100, state.range(1), state.range(2));
+	const auto* cached = Cached(state, service);
+	if (!cached)
+	{
+		return;
+	}
+	Updater updater = *cached;
+	auto lookup = Lookup(updater);
+	for (auto _ : state)
+	{
+		for (auto id : service.ids)
+		{
+			updater.UpdateWeight(id, 0, lookup.data());
+		}
+		for (auto id : service.ids)
+		{
+			updater.UpdateWeight(id, MAX_WEIGHT, lookup.data());
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * service.ids.size() * 2);
+}
+BENCHMARK(BM_UpdateWeightDrain)
+        ->ArgsProduct({{10, 100, 1000}, {1, 20}, {1}})
+        ->ArgNames({"reals", "cells", "lookup_factor"})
+        ->Unit(benchmark::kMillisecond);
+
+// one real brought up from zero in steps of 10 and back
+void BM_UpdateWeightRamp(benchmark::State& state)
+{
+	Service service(state.range(0), 100, state.range(1), state.range(2));
+	const auto* cached = Cached(state, service);
+	if (!cached)
+	{
+		return;
+	}
+	Updater updater = *cached;
+	auto lookup = Lookup(updater);
+	RealId id = service.ids.front();
+	for (auto _ : state)
+	{
+		for (Weight w = MAX_WEIGHT; w != 0; w -= 10)
+		{
+			updater.UpdateWeight(id, w - 10, lookup.data());
+		}
+		for (Weight w = 0; w != MAX_WEIGHT; w += 10)
+		{
+			updater.UpdateWeight(id, w + 10, lookup.data());
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * 20);
+}
+BENCHMARK(BM_UpdateWeightRamp)
+        ->Apply(Lookups);
+
+void BM_SetWeights(benchmark::State& state)
+{
+	Service service(state.range(0), 100, state.range(1), state.range(2));
+	const auto* cached = Cached(state, service);
+	if (!cached)
+	{
+		return;
+	}
+	Updater updater = *cached;
+	std::vector<Weight> half(service.weights.size(), MAX_WEIGHT / 2);
+	for (auto _ : state)
+	{
+		updater.SetWeights(service.ids.data(), half.data(), service.ids.size());
+		updater.SetWeights(service.ids.data(), service.weights.data(), service.ids.size());
+	}
+	state.SetItemsProcessed(state.iterations() * service.ids.size() * 2);
+}
+BENCHMARK(BM_SetWeights)
+        ->Apply(Lookups);
+
+// per packet lookup of random flow hashes
+void BM_Select(benchmark::State& state)
+{
+	Service service(state.range(0), 100, state.range(1), state.range(2));
+	const auto* updater = Cached(state, service);
+	if (!updater)
+	{
+		return;
+	}
+	auto lookup = Lookup(*updater);
+	std::mt19937 gen(42);
+	std::vector<std::uint32_t> hashes(1 << 16);
+	for (auto& h : hashes)
+	{
+		h = gen();
+	}
+	std::size_t i{};
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(lookup[hashes[i++ & (hashes.size() - 1)] % lookup.size()]);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Select)
+        ->Apply(Lookups);
+
+} // namespace
+
+BENCHMARK_MAIN();
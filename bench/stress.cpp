@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "chash.hpp"
+
+/* Dataplane workers read the lookup in bursts while a control plane thread
+ * changes weights of random reals in the same lookup. Reports reader
+ * throughput, reader burst stall percentiles and writer update latency.
+ */
+
+namespace
+{
+
+using Updater = chash::WeightUpdater;
+using RealId = Updater::RealId;
+using Weight = Updater::Weight;
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+	std::size_t readers = 2;
+	std::size_t reals = 1000;
+	std::size_t mappings = 100;
+	std::size_t cells = 20;
+	std::size_t burst = 32;
+	// updates per second, 0 is as fast as possible
+	std::size_t rate = 1000;
+	// fractions are allowed, must be positive
+	double seconds = 5;
+};
+
+using chash::Histogram;
+
+struct Reader
+{
+	Histogram stalls;
+	std::uint64_t packets{};
+	std::uint64_t checksum{};
+};
+
+std::optional<std::size_t> ParseSize(std::string_view value)
+{
+	char* end{};
+	std::string s(value);
+	auto result = std::strtoull(s.c_str(), &end, 10);
+	if (s.empty() || *end != '\0')
+	{
+		return std::nullopt;
+	}
+	return result;
+}
+
+std::optional<double> ParseSeconds(std::string_view value)
+{
+	char* end{};
+	std::string s(value);
+	auto result = std::strtod(s.c_str(), &end);
+	if (s.empty() || *end != '\0' || !std::isfinite(result) || result <= 0)
+	{
+		return std::nullopt;
+	}
+	return result;
+}
+
+[[noreturn]] void Usage(const char* program)
+{
+	std::cerr << "Usage: " << program
+	          << " [--readers N] [--reals N] [--mappings N] [--cells N] [--burst N] [--rate N] [--seconds S]\n";
+	std::exit(EXIT_FAILURE);
+}
+
+std::size_t* SizeOption(Options& options, std::string_view flag)
+{
+	if (flag == "--readers")
+	{
+		return &options.readers;
+	}
+	if (flag == "--reals")
+	{
+		return &options.reals;
+	}
+	if (flag == "--mappings")
+	{
+		return &options.mappings;
+	}
+	if (flag == "--cells")
+	{
+		return &options.cells;
+	}
+	if (flag == "--burst")
+	{
+		return &options.burst;
+	}
+	if (flag == "--rate")
+	{
+		return &options.rate;
+	}
+	return nullptr;
+}
+
+Options Parse(int argc, char* argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; i += 2)
+	{
+		std::string_view flag = argv[i];
+		std::size_t* size = SizeOption(options, flag);
+		if (size == nullptr && flag != "--seconds")
+		{
+			std::cerr << "Unknown argument '" << flag << "'\n";
+			Usage(argv[0]);
+		}
+		if (i + 1 == argc)
+		{
+			std::cerr << flag << " requires a value\n";
+			Usage(argv[0]);
+		}
+		if (size == nullptr)
+		{
+			auto seconds = ParseSeconds(argv[i + 1]);
+			if (!seconds)
+			{
+				std::cerr << "invalid value for " << flag << '\n';
+				Usage(argv[0]);
+			}
+			options.seconds = seconds.value();
+			continue;
+		}
+		auto value = ParseSize(argv[i + 1]);
+		if (!value)
+		{
+			std::cerr << "invalid value for " << flag << '\n';
+			Usage(argv[0]);
+		}
+		*size = value.value();
+	}
+	options.burst = std::max<std::size_t>(options.burst, 1);
+	return options;
+}
+
+void Print(std::string_view name, const Histogram& h)
+{
+	std::cout << name << "_ns: p50=" << h.Percentile(0.5) << " p99=" << h.Percentile(0.99)
+	          << " p999=" << h.Percentile(0.999) << " max=" << h.Max() << '\n';
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	Options options = Parse(argc, argv);
+
+	std::vector<std::string> reals;
+	std::vector<RealId> ids;
+	std::vector<Weight> weights(options.reals, chash::DefaultConfig::MaxWeight);
+	for (std::size_t i = 0; i < options.reals; ++i)
+	{
+		reals.push_back("2a02:6b8:0:" + std::to_string(i) + "::1");
+		ids.push_back(i + 1);
+	}
+	auto updater = chash::MakeWeightUpdater(
+	        reals.data(), ids.data(), weights.data(), options.reals, options.mappings, options.cells);
+	if (!updater)
+	{
+		std::cerr << "failed to build updater\n";
+		return EXIT_FAILURE;
+	}
+	std::vector<RealId> lookup(updater->LookupSize());
+	updater->InitLookup(lookup.data());
+
+	std::atomic<bool> stop{};
+	std::vector<Reader> results(options.readers);
+	std::vector<std::thread> readers;
+	for (std::size_t r = 0; r < options.readers; ++r)
+	{
+		readers.emplace_back([&, r] {
+			auto& result = results[r];
+			std::mt19937 gen(r + 1);
+			std::vector<std::uint32_t> flows(1 << 16);
+			std::generate(flows.begin(), flows.end(), gen);
+			std::size_t next{};
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				auto start = Clock::now();
+				for (std::size_t k = 0; k < options.burst; ++k)
+				{
+					auto hash = flows[next++ & (flows.size() - 1)];
+					// the writer updates cells in place, as with a shared lookup
+					result.checksum += __atomic_load_n(&lookup[hash % lookup.size()], __ATOMIC_RELAXED);
+				}
+				auto end = Clock::now();
+				result.stalls.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+				result.packets += options.burst;
+			}
+		});
+	}
+
+	Histogram updates;
+	std::mt19937 gen(0);
+	std::uniform_int_distribution<std::size_t> real(0, options.reals - 1);
+	std::uniform_int_distribution<Weight> weight(0, chash::DefaultConfig::MaxWeight);
+	auto begin = Clock::now();
+	auto deadline = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+	for (std::size_t n = 0; Clock::now() < deadline; ++n)
+	{
+		if (options.rate != 0)
+		{
+			std::this_thread::sleep_until(begin + std::chrono::nanoseconds(n * 1'000'000'000ull / options.rate));
+		}
+		RealId id = ids[real(gen)];
+		Weight w = weight(gen);
+		auto start = Clock::now();
+		updater->UpdateWeight(id, w, lookup.data());
+		updates.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+	}
+	stop = true;
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+	double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+	Histogram stalls;
+	std::uint64_t packets{};
+	std::uint64_t checksum{};
+	for (const auto& result : results)
+	{
+		stalls.Merge(result.stalls);
+		packets += result.packets;
+		checksum += result.checksum;
+	}
+	std::cout << "readers: " << options.readers << " burst: " << options.burst << '\n'
+	          << "reader_mpps: " << packets / elapsed / 1e6 << '\n';
+	Print("reader_burst", stalls);
+	std::cout << "writer_updates: " << updates.Total() << '\n';
+	Print("writer_update", updates);
+	std::cout << "checksum: " << checksum << '\n';
+	return EXIT_SUCCESS;
+}
@@ -20,25 +20,30 @@ def RunIteration(mappings=10000, cells=20):
     return pres.stdout
 
 
-def XCellsYMappingsMaxError(min_mappings=1,
-                            min_cells=1,
-                            max_mappings=200,
-                            max_cells=20,
-                            step_mappings=10,
-                            step_cells=1):
-    x = []
-    y = []
-    z = []
-    count = 0
-    for mappings in range(min_mappings, max_mappings, step_mappings):
-        for cells in range(min_cells, max_cells, step_cells):
-            x.append(mappings)
-            y.append(cells)
-            z.append(float(RunIteration(mappings, cells)))
-            count += 1
-            if count % 100 == 0:
-                print(count, "\n")
-    return [x, y, z]
+def Sweep(min_mappings=1,
+          min_cells=1,
+          max_mappings=200,
+          max_cells=20,
+          step_mappings=10,
+          step_cells=1):
+    pres = subprocess.run(["../build/demo/demo",
+                           "--mappings-range",
+                           f"{min_mappings}:{max_mappings}:{step_mappings}",
+                           "--cells-range",
+                           f"{min_cells}:{max_cells}:{step_cells}",
+                           "sweep"],
+                          capture_output=True,
+                          text=True,
+                          check=True)
+    df = pd.read_csv(StringIO(pres.stdout), sep=";")
+    return df[df["built"] == 1]
+
+
+def XCellsYMappingsMaxError(**grid):
+    df = Sweep(**grid)
+    return [df["mappings"].values.tolist(),
+            df["cells"].values.tolist(),
+            df["max_error"].values.tolist()]
 
 
 def PlotXCellsYMappingsMaxError():
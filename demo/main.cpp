@@ -1,15 +1,21 @@
 #include <arpa/inet.h>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <fstream>
+#include <memory_resource>
 #include <iostream>
 #include <set>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <unordered_set>
 
+#include "analytics.hpp"
+#include "builder.hpp"
 #include "chash.hpp"
+#include "journal.hpp"
 #include "printers.hpp"
 #include "report.hpp"
 
@@ -101,23 +107,45 @@ static constexpr std::string_view FLAG_CELLS_PER_WEIGHT = "--cells"sv;
 static constexpr std::string_view FLAG_CELLS_PER_WEIGHT_SHORT = "-c"sv;
 static constexpr std::string_view FLAG_MAPPINGS = "--mappings"sv;
 static constexpr std::string_view FLAG_MAPPINGS_SHORT = "-m"sv;
-
+static constexpr std::string_view FLAG_JOURNAL = "--journal"sv;
+static constexpr std::string_view FLAG_JOURNAL_SHORT = "-j"sv;
+static constexpr std::string_view FLAG_MAPPINGS_RANGE = "--mappings-range"sv;
+static constexpr std::string_view FLAG_CELLS_RANGE = "--cells-range"sv;
+static constexpr std::string_view FLAG_THREADS = "--threads"sv;
+static constexpr std::string_view FLAG_OUTPUT = "--output"sv;
+static constexpr std::string_view FLAG_OUTPUT_SHORT = "-o"sv;
+
+static constexpr std::string_view CMD_REPORT_AFFINITY = "affinity";
+static constexpr std::string_view CMD_REPORT_ALLOCATIONS = "allocations";
 static constexpr std::string_view CMD_REPORT_MAXERROR = "maxerror";
 static constexpr std::string_view CMD_REPORT_MAXERROR_SERIES = "maxerrorseries";
 static constexpr std::string_view CMD_REPORT_MISSING = "missing";
 static constexpr std::string_view CMD_REPORT_OVERLAP = "overlap";
+static constexpr std::string_view CMD_REPORT_RECORD = "record";
+static constexpr std::string_view CMD_REPORT_REPLAY = "replay";
+static constexpr std::string_view CMD_REPORT_SCALING = "scaling";
+static constexpr std::string_view CMD_REPORT_SWEEP = "sweep";
 static constexpr std::string_view CMD_REPORT_TIME = "time";
 static constexpr std::string_view CMD_REPORT_YIELD_UNIFORMITY_ABS = "yielduniabs";
 static constexpr std::string_view CMD_REPORT_YIELD_UNIFORMITY_ABS_MAX = "maxyielduniabs";
 
 static constexpr std::size_t DEFAULT_CELLS_PER_WEIGHT = 20;
 static constexpr std::size_t DEFAULT_MAPPINGS = 20000;
+static constexpr std::string_view DEFAULT_JOURNAL = "chash.journal"sv;
+// min:max:step, max excluded as in graph.py
+static constexpr std::array<std::size_t, 3> DEFAULT_MAPPINGS_RANGE = {1, 200, 10};
+static constexpr std::array<std::size_t, 3> DEFAULT_CELLS_RANGE = {1, 20, 1};
 
 enum class MainArg
 {
 	CONFIG,
 	CELLS,
 	MAPPINGS,
+	JOURNAL,
+	MAPPINGS_RANGE,
+	CELLS_RANGE,
+	THREADS,
+	OUTPUT,
 	STDIN,
 	UNKNOWN
 };
@@ -132,10 +160,16 @@ enum class ConfigSource
 enum class Command
 {
 	NONE,
+	AFFINITY,
+	ALLOCATIONS,
 	MAXERROR,
 	MAXERRORSERIES,
 	MISSING,
 	OVERLAP,
+	RECORD,
+	REPLAY,
+	SCALING,
+	SWEEP,
 	TIME,
 	YIELD_UNIFORMITY_ABS,
 	YIELD_UNIFORMITY_ABS_MAX
@@ -158,6 +192,31 @@ MainArg ParseArg(const char* str)
 		return MainArg::MAPPINGS;
 	}
 
+	if (str == FLAG_JOURNAL_SHORT || str == FLAG_JOURNAL)
+	{
+		return MainArg::JOURNAL;
+	}
+
+	if (str == FLAG_MAPPINGS_RANGE)
+	{
+		return MainArg::MAPPINGS_RANGE;
+	}
+
+	if (str == FLAG_CELLS_RANGE)
+	{
+		return MainArg::CELLS_RANGE;
+	}
+
+	if (str == FLAG_THREADS)
+	{
+		return MainArg::THREADS;
+	}
+
+	if (str == FLAG_OUTPUT_SHORT || str == FLAG_OUTPUT)
+	{
+		return MainArg::OUTPUT;
+	}
+
 	if (str == FLAG_STDIN)
 	{
 		return MainArg::STDIN;
@@ -184,8 +243,32 @@ std::optional<std::size_t> ParseUint64(const std::string& s)
 	}
 }
 
+/* @brief Parses "min:max:step" with min < max and step > 0.
+ */
+std::optional<std::array<std::size_t, 3>> ParseRange(const std::string& s)
+{
+	std::array<std::size_t, 3> range;
+	std::istringstream is(s);
+	char first{};
+	char second{};
+	if (!(is >> range[0] >> first >> range[1] >> second >> range[2]) || !is.eof() ||
+	    first != ':' || second != ':' || range[0] >= range[1] || range[2] == 0)
+	{
+		return std::nullopt;
+	}
+	return range;
+}
+
 std::optional<Command> ParseCmd(const char* str)
 {
+	if (str == CMD_REPORT_AFFINITY)
+	{
+		return Command::AFFINITY;
+	}
+	if (str == CMD_REPORT_ALLOCATIONS)
+	{
+		return Command::ALLOCATIONS;
+	}
 	if (str == CMD_REPORT_MAXERROR)
 	{
 		return Command::MAXERROR;
@@ -202,6 +285,22 @@ std::optional<Command> ParseCmd(const char* str)
 	{
 		return Command::OVERLAP;
 	}
+	if (str == CMD_REPORT_RECORD)
+	{
+		return Command::RECORD;
+	}
+	if (str == CMD_REPORT_REPLAY)
+	{
+		return Command::REPLAY;
+	}
+	if (str == CMD_REPORT_SCALING)
+	{
+		return Command::SCALING;
+	}
+	if (str == CMD_REPORT_SWEEP)
+	{
+		return Command::SWEEP;
+	}
 	if (str == CMD_REPORT_TIME)
 	{
 		return Command::TIME;
@@ -220,12 +319,8 @@ std::optional<Command> ParseCmd(const char* str)
 
 std::unordered_map<std::uint32_t, std::size_t> CellCount(const std::vector<std::uint32_t>& lookup)
 {
-	std::unordered_map<std::uint32_t, std::size_t> cells;
-	for (const auto& id : lookup)
-	{
-		++cells[id];
-	}
-	return cells;
+	auto counts = chash::CellCounts(lookup.data(), lookup.size());
+	return {counts.begin(), counts.end()};
 }
 
 double MaxError(const std::vector<std::uint32_t>& ids,
@@ -448,16 +543,7 @@ double diff(const lookup_t& a, const lookup_t& b)
 		throw std::invalid_argument{"Mismatched lookups size"};
 	}
 
-	std::size_t mismatch{};
-	for (std::size_t i = 0; i < a.size(); ++i)
-	{
-		if (a[i] != b[i])
-		{
-			++mismatch;
-		}
-	}
-
-	return static_cast<double>(mismatch) / a.size();
+	return static_cast<double>(chash::CountMismatches(a.data(), b.data(), a.size())) / a.size();
 }
 
 double same(const lookup_t& a, const lookup_t& b)
@@ -467,16 +553,7 @@ double same(const lookup_t& a, const lookup_t& b)
 		throw std::invalid_argument{"Mismatched lookups size"};
 	}
 
-	std::size_t match{};
-	for (std::size_t i = 0; i < a.size(); ++i)
-	{
-		if (a[i] == b[i])
-		{
-			++match;
-		}
-	}
-
-	return static_cast<double>(match) / a.size();
+	return static_cast<double>(a.size() - chash::CountMismatches(a.data(), b.data(), a.size())) / a.size();
 }
 
 std::unordered_map<std::uint32_t, std::uint32_t> dist(const lookup_t& a, const lookup_t& b)
@@ -486,16 +563,8 @@ std::unordered_map<std::uint32_t, std::uint32_t> dist(const lookup_t& a, const l
 		throw std::invalid_argument{"Mismatched lookups size"};
 	}
 
-	std::unordered_map<std::uint32_t, std::uint32_t> result;
-	for (std::size_t i = 0; i < a.size(); ++i)
-	{
-		if (a[i] != b[i])
-		{
-			++result[b[i]];
-		}
-	}
-
-	return result;
+	auto moved = chash::MovedCells(a.data(), b.data(), a.size());
+	return {moved.begin(), moved.end()};
 }
 
 void Overlap(std::set<IpV6Address>& ipset, std::uint32_t mappings, std::uint32_t cells)
@@ -606,6 +675,537 @@ void Time(std::set<IpV6Address>& ipset, std::uint32_t mappings, std::uint32_t ce
 	          << std::chrono::duration_cast<std::chrono::duration<double>>(end - init).count() << '\n';
 }
 
+void Scaling(const std::set<IpV6Address>& ipset, std::uint32_t mappings, std::uint32_t cells)
+{
+	IpV6Gen gen(ipset);
+	std::vector<IpV6Address> reals;
+
+	std::cout << "reals;seconds;microseconds_per_real\n";
+	for (std::size_t cnt = 10; cnt <= 100000; cnt *= 10)
+	{
+		while (reals.size() < cnt)
+		{
+			reals.push_back(gen.Unique());
+		}
+		std::vector<std::uint32_t> ids(cnt, 0);
+		std::iota(ids.begin(), ids.end(), 1);
+		std::vector<std::uint32_t> weights(cnt, 100);
+
+		auto start = std::chrono::steady_clock::now();
+		auto updater = chash::MakeWeightUpdater(
+		        reals.data(), ids.data(), weights.data(), cnt, mappings, cells);
+		auto end = std::chrono::steady_clock::now();
+		if (!updater)
+		{
+			std::cout << cnt << ";-;-\n";
+			continue;
+		}
+		double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+		std::cout << cnt << ";" << seconds << ";" << seconds * 1e6 / cnt << '\n';
+	}
+}
+
+/* @brief Counts allocations of one construction: all of MakeWeightUpdater,
+ * temporaries of UpdaterBuilder after it has built the same service once and
+ * the resulting updater alone.
+ */
+void Allocations(const std::set<IpV6Address>& ipset, std::uint32_t mappings, std::uint32_t cells)
+{
+	IpV6Gen gen(ipset);
+	std::vector<IpV6Address> reals;
+	chash::CountingResource scratch;
+	chash::UpdaterBuilder builder(&scratch);
+
+	std::cout << "reals;make;builder_scratch;updater\n";
+	for (std::size_t cnt = 10; cnt <= 10000; cnt *= 10)
+	{
+		while (reals.size() < cnt)
+		{
+			reals.push_back(gen.Unique());
+		}
+		std::vector<std::uint32_t> ids(cnt, 0);
+		std::iota(ids.begin(), ids.end(), 1);
+		std::vector<std::uint32_t> weights(cnt, 100);
+		auto size = chash::WeightUpdater::LookupRequiredSize(cnt, cells);
+
+		chash::CountingResource make;
+		auto updater = chash::MakeWeightUpdater(
+		        reals.data(), ids.data(), weights.data(), cnt, mappings, cells, size, &make);
+		if (!updater)
+		{
+			std::cout << cnt << ";-;-;-\n";
+			continue;
+		}
+		updater.reset();
+
+		chash::CountingResource result;
+		for (int round = 0; round < 2; ++round)
+		{
+			scratch.allocations = 0;
+			result.allocations = 0;
+			builder.MakeWeightUpdater(
+			        reals.data(), ids.data(), weights.data(), cnt, mappings, cells, size, &result);
+		}
+		std::cout << cnt << ";" << make.allocations << ";" << scratch.allocations << ";" << result.allocations << '\n';
+	}
+}
+
+/* @brief Prints max weight error of the configured service, one number as
+ * graph.py expects.
+ */
+void MaxErrorPoint(const std::vector<std::string>& reals,
+                   const std::vector<std::uint32_t>& ids,
+                   const std::vector<std::uint32_t>& weights,
+                   std::size_t mappings,
+                   std::size_t cells)
+{
+	auto updater = chash::MakeWeightUpdater(reals.data(), ids.data(), weights.data(), reals.size(), mappings, cells);
+	if (!updater)
+	{
+		std::cerr << "Failed to build updater\n";
+		std::exit(EXIT_FAILURE);
+	}
+	std::vector<std::uint32_t> lookup(updater->LookupSize());
+	updater->InitLookup(lookup.data());
+	std::cout << MaxError(ids, weights, lookup) << '\n';
+}
+
+/* @brief Evaluates the configured service over the grid of \mappings_range
+ * and \cells_range on \threads threads: max weight error, build and
+ * InitLookup time and memory of the updater and the lookup. A thread takes
+ * all cell counts of one mappings value, so side rings are built once per
+ * mappings value and taken from a ring cache for the rest of them, the
+ * cached column tells which build times exclude rings. Writes CSV to stdout
+ * or to \output, JSON if its name ends with ".json".
+ */
+void Sweep(const std::vector<std::string>& reals,
+           const std::vector<std::uint32_t>& ids,
+           const std::vector<std::uint32_t>& weights,
+           const std::array<std::size_t, 3>& mappings_range,
+           const std::array<std::size_t, 3>& cells_range,
+           std::size_t threads,
+           const std::optional<std::string>& output)
+{
+	struct Point
+	{
+		std::size_t mappings;
+		std::size_t cells;
+		bool built;
+		bool cached;
+		double max_error;
+		std::uint64_t build_ns;
+		std::uint64_t init_ns;
+		std::size_t updater_bytes;
+		std::size_t lookup_bytes;
+	};
+
+	std::vector<std::size_t> mappings_values;
+	for (std::size_t m = mappings_range[0]; m < mappings_range[1]; m += mappings_range[2])
+	{
+		mappings_values.push_back(m);
+	}
+	std::vector<std::size_t> cells_values;
+	for (std::size_t c = cells_range[0]; c < cells_range[1]; c += cells_range[2])
+	{
+		cells_values.push_back(c);
+	}
+
+	std::vector<Point> points(mappings_values.size() * cells_values.size());
+	std::atomic<std::size_t> next{};
+	auto worker = [&]() {
+		chash::UpdaterBuilder builder;
+		chash::BasicRingCache<std::string, chash::DefaultConfig> cache(mappings_values.back());
+		for (std::size_t row; (row = next++) < mappings_values.size();)
+		{
+			for (std::size_t col = 0; col < cells_values.size(); ++col)
+			{
+				Point& point = points[row * cells_values.size() + col];
+				point.mappings = mappings_values[row];
+				point.cells = cells_values[col];
+
+				chash::CountingResource memory;
+				auto hits = cache.Statistics().hits;
+				auto start = std::chrono::steady_clock::now();
+				auto updater = builder.MakeWeightUpdater(reals.data(),
+				                                         ids.data(),
+				                                         weights.data(),
+				                                         reals.size(),
+				                                         point.mappings,
+				                                         point.cells,
+				                                         chash::WeightUpdater::LookupRequiredSize(reals.size(), point.cells),
+				                                         &memory,
+				                                         &cache);
+				auto built = std::chrono::steady_clock::now();
+				point.built = updater.has_value();
+				point.cached = cache.Statistics().hits != hits;
+				if (!updater)
+				{
+					continue;
+				}
+				std::vector<std::uint32_t> lookup(updater->LookupSize());
+				auto init = std::chrono::steady_clock::now();
+				updater->InitLookup(lookup.data());
+				auto end = std::chrono::steady_clock::now();
+
+				point.max_error = MaxError(ids, weights, lookup);
+				point.build_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(built - start).count();
+				point.init_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - init).count();
+				point.updater_bytes = memory.bytes;
+				point.lookup_bytes = lookup.size() * sizeof(std::uint32_t);
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	for (std::size_t t = 1; t < std::min(threads, mappings_values.size()); ++t)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto& w : workers)
+	{
+		w.join();
+	}
+
+	std::ofstream file;
+	if (output)
+	{
+		file.open(output.value());
+		if (!file.is_open())
+		{
+			std::cerr << "Failed to open '" << output.value() << "'\n";
+			std::exit(EXIT_FAILURE);
+		}
+	}
+	std::ostream& out = output ? file : std::cout;
+	bool json = output && output->size() >= 5 && output->compare(output->size() - 5, 5, ".json") == 0;
+	static constexpr std::array<std::string_view, 9> COLUMNS = {
+	        "mappings", "cells", "built", "cached", "max_error", "build_ns", "init_ns", "updater_bytes", "lookup_bytes"};
+	if (json)
+	{
+		out << "[\n";
+	}
+	else
+	{
+		for (std::size_t c = 0; c < COLUMNS.size(); ++c)
+		{
+			out << (c == 0 ? "" : ";") << COLUMNS[c];
+		}
+		out << '\n';
+	}
+	for (std::size_t i = 0; i < points.size(); ++i)
+	{
+		const auto& p = points[i];
+		std::array<std::string, 9> values = {std::to_string(p.mappings),
+		                                     std::to_string(p.cells),
+		                                     std::to_string(p.built),
+		                                     std::to_string(p.cached),
+		                                     std::to_string(p.max_error),
+		                                     std::to_string(p.build_ns),
+		                                     std::to_string(p.init_ns),
+		                                     std::to_string(p.updater_bytes),
+		                                     std::to_string(p.lookup_bytes)};
+		for (std::size_t c = 0; c < COLUMNS.size(); ++c)
+		{
+			if (json)
+			{
+				out << (c == 0 ? "  {" : ", ") << '"' << COLUMNS[c] << "\": " << values[c];
+			}
+			else
+			{
+				out << (c == 0 ? "" : ";") << values[c];
+			}
+		}
+		out << (json ? (i + 1 == points.size() ? "}\n" : "},\n") : "\n");
+	}
+	if (json)
+	{
+		out << "]\n";
+	}
+}
+
+/* @brief Replays random churn of real weights against a population of long
+ * lived flows. Every flow sticks to the real it was first mapped to, a flow
+ * mapped elsewhere after an update is broken: expectedly if its real lost
+ * weight or it moved to the real that gained weight, needlessly otherwise.
+ * Draining a real to zero and bringing it back stand for membership changes
+ * since real set of an updater is fixed. Prints breakage and lookup rate per
+ * step and totals.
+ */
+void FlowAffinity(std::set<IpV6Address>& ipset, std::uint32_t mappings, std::uint32_t cells)
+{
+	static constexpr std::size_t FLOWS = 100000;
+	static constexpr std::size_t STEPS = 200;
+	static constexpr double MEAN_LIFETIME = 50;
+
+	struct Flow
+	{
+		std::uint32_t hash;
+		std::uint32_t real;
+		std::size_t death;
+	};
+
+	auto updater = PrepareUpdater(ipset, mappings, cells, 100);
+	std::size_t cnt = ipset.size();
+	std::vector<std::uint32_t> weights(cnt + 1, 100);
+	std::vector<std::uint32_t> lookup(updater.LookupSize());
+	updater.InitLookup(lookup.data());
+
+	std::mt19937 gen(42);
+	std::exponential_distribution<double> lifetime(1 / MEAN_LIFETIME);
+	std::uniform_int_distribution<std::uint32_t> real(1, cnt);
+	std::uniform_real_distribution<double> event(0, 1);
+	std::vector<Flow> flows;
+	flows.reserve(FLOWS);
+
+	std::size_t total_shed{};
+	std::size_t total_gained{};
+	std::size_t total_needless{};
+	std::size_t total_born{};
+	std::size_t lookups{};
+	double seconds{};
+
+	std::cout << "step;live;shed;gained;needless;mpps\n";
+	for (std::size_t step = 0; step < STEPS; ++step)
+	{
+		flows.erase(std::remove_if(flows.begin(), flows.end(), [&](const Flow& f) {
+			            return f.death <= step;
+		            }),
+		            flows.end());
+		while (flows.size() < FLOWS)
+		{
+			std::uint32_t hash = gen();
+			flows.push_back(Flow{hash, lookup[hash % lookup.size()], step + 1 + static_cast<std::size_t>(lifetime(gen))});
+			++total_born;
+		}
+
+		// drain an active real, bring back a drained one or reweight
+		std::uint32_t id = real(gen);
+		double kind = event(gen);
+		std::uint32_t was = weights[id];
+		std::size_t active = std::count_if(weights.begin() + 1, weights.end(), [](std::uint32_t w) {
+			return w != 0;
+		});
+		if (kind < 0.4 && weights[id] != 0 && active > 1)
+		{
+			weights[id] = 0;
+		}
+		else if (kind < 0.8 && weights[id] == 0)
+		{
+			weights[id] = 100;
+		}
+		else if (weights[id] != 0)
+		{
+			weights[id] = std::uniform_int_distribution<std::uint32_t>(10, 100)(gen);
+		}
+		updater.UpdateWeight(id, weights[id], lookup.data());
+
+		std::size_t shed{};
+		std::size_t gained{};
+		std::size_t needless{};
+		auto start = std::chrono::steady_clock::now();
+		for (auto& f : flows)
+		{
+			if (auto now = lookup[f.hash % lookup.size()]; now != f.real)
+			{
+				if (f.real == id && weights[id] < was)
+				{
+					++shed;
+				}
+				else if (now == id && weights[id] > was)
+				{
+					++gained;
+				}
+				else
+				{
+					++needless;
+				}
+				f.death = step;
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+		seconds += elapsed;
+		lookups += flows.size();
+		total_shed += shed;
+		total_gained += gained;
+		total_needless += needless;
+		std::cout << step << ";" << flows.size() << ";" << shed << ";" << gained << ";" << needless << ";"
+		          << flows.size() / elapsed / 1e6 << '\n';
+	}
+	std::cout << "total;" << total_born << ";" << total_shed << ";" << total_gained << ";" << total_needless << ";"
+	          << lookups / seconds / 1e6 << '\n';
+}
+
+/* @brief Writes journal of a synthetic control plane to \path: health
+ * check flaps of random reals, canary ramps of a drained real and periodic
+ * reweights of the whole service.
+ */
+void RecordJournal(std::set<IpV6Address>& ipset, std::uint32_t mappings, std::uint32_t cells, const std::string& path)
+{
+	static constexpr std::size_t ROUNDS = 100;
+	static constexpr std::size_t FLAPS = 20;
+	static constexpr std::uint32_t RAMP_STEP = 10;
+
+	auto updater = PrepareUpdater(ipset, mappings, cells, 100);
+	std::uint32_t cnt = ipset.size();
+	std::vector<std::uint32_t> ids(cnt);
+	std::iota(ids.begin(), ids.end(), 1);
+	std::vector<std::uint32_t> weights(cnt, 100);
+	std::vector<std::uint32_t> lookup(updater.LookupSize());
+	updater.InitLookup(lookup.data());
+
+	chash::JournalWriter writer;
+	writer.Declare(0, ids.data(), weights.data(), cnt);
+	updater.SetRecorder(&writer, 0);
+
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<std::uint32_t> real(0, cnt - 1);
+	std::uniform_int_distribution<std::uint32_t> weight(10, 100);
+	for (std::size_t round = 0; round < ROUNDS; ++round)
+	{
+		for (std::size_t flap = 0; flap < FLAPS; ++flap)
+		{
+			std::uint32_t id = ids[real(gen)];
+			updater.UpdateWeight(id, 0, lookup.data());
+			updater.UpdateWeight(id, weights[id - 1], lookup.data());
+		}
+
+		std::uint32_t canary = ids[real(gen)];
+		for (std::uint32_t w = 0; w <= weights[canary - 1]; w += RAMP_STEP)
+		{
+			updater.UpdateLookup(&canary, &w, 1, lookup.data());
+		}
+		updater.UpdateLookup(&canary, &weights[canary - 1], 1, lookup.data());
+
+		if (round % 10 == 9)
+		{
+			std::generate(weights.begin(), weights.end(), [&]() {
+				return weight(gen);
+			});
+			updater.UpdateLookup(ids.data(), weights.data(), cnt, lookup.data());
+		}
+	}
+	updater.SetRecorder(nullptr);
+
+	auto data = writer.Data();
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(data.data()), data.size());
+	if (!out)
+	{
+		std::cerr << "Failed to write journal '" << path << "'\n";
+		std::exit(EXIT_FAILURE);
+	}
+	std::cout << "events;bytes\n";
+	std::cout << writer.Events() << ";" << data.size() << '\n';
+}
+
+/* @brief Replays journal at \path at maximum speed. Services are built from
+ * their declared initial weights with ids for reals, so the layout differs
+ * from the recorded one while the work per event stays comparable. Prints
+ * latency percentiles per operation in nanoseconds and overall throughput.
+ */
+void ReplayJournal(std::uint32_t mappings, std::uint32_t cells, const std::string& path)
+{
+	struct Service
+	{
+		std::optional<chash::WeightUpdater> updater;
+		std::vector<std::uint32_t> lookup;
+	};
+
+	std::ifstream in(path, std::ios::binary);
+	std::vector<std::uint8_t> data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+	auto reader = chash::JournalReader::Open(data.data(), data.size());
+	if (!reader)
+	{
+		std::cerr << "Failed to open journal '" << path << "'\n";
+		std::exit(EXIT_FAILURE);
+	}
+	std::vector<chash::JournalReader::Record> records;
+	while (auto record = reader->Next())
+	{
+		records.push_back(std::move(record.value()));
+	}
+	if (!reader->Complete())
+	{
+		std::cerr << "Journal is truncated after " << records.size() << " records\n";
+	}
+
+	std::map<std::uint32_t, Service> services;
+	std::array<chash::Histogram, static_cast<std::size_t>(chash::Operation::COUNT)> latency;
+	std::array<std::size_t, static_cast<std::size_t>(chash::Operation::COUNT)> events{};
+	std::uint64_t busy{};
+	for (const auto& r : records)
+	{
+		auto& service = services[r.service];
+		if (r.op != chash::Operation::MAKE && !service.updater)
+		{
+			continue;
+		}
+		auto start = std::chrono::steady_clock::now();
+		switch (r.op)
+		{
+			case chash::Operation::MAKE:
+				service.updater = chash::MakeWeightUpdater(r.ids.data(),
+				                                           r.ids.data(),
+				                                           r.weights.data(),
+				                                           r.ids.size(),
+				                                           mappings,
+				                                           cells);
+				if (!service.updater)
+				{
+					std::cerr << "Failed to build service " << r.service << '\n';
+					std::exit(EXIT_FAILURE);
+				}
+				service.lookup.resize(service.updater->LookupSize());
+				service.updater->InitLookup(service.lookup.data());
+				break;
+			case chash::Operation::UPDATE_WEIGHT:
+				service.updater->UpdateWeight(r.ids.front(), r.weights.front(), service.lookup.data());
+				break;
+			case chash::Operation::UPDATE_LOOKUP:
+				service.updater->UpdateLookup(r.ids.data(), r.weights.data(), r.ids.size(), service.lookup.data());
+				break;
+			case chash::Operation::SET_WEIGHTS:
+				service.updater->SetWeights(r.ids.data(), r.weights.data(), r.ids.size());
+				break;
+			default:
+				break;
+		}
+		auto end = std::chrono::steady_clock::now();
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		latency[static_cast<std::size_t>(r.op)].Add(ns);
+		events[static_cast<std::size_t>(r.op)] += r.ids.size();
+		if (r.op != chash::Operation::MAKE)
+		{
+			busy += ns;
+		}
+	}
+
+	static constexpr std::array<std::string_view, static_cast<std::size_t>(chash::Operation::COUNT)> NAMES = {
+	        "make", "initlookup", "updateweight", "updatelookup", "setweights"};
+	std::cout << "op;records;events;p50;p90;p99;p999;max\n";
+	std::size_t replayed{};
+	for (std::size_t op = 0; op < latency.size(); ++op)
+	{
+		const auto& h = latency[op];
+		if (h.Total() == 0)
+		{
+			continue;
+		}
+		if (op != static_cast<std::size_t>(chash::Operation::MAKE))
+		{
+			replayed += events[op];
+		}
+		std::cout << NAMES[op] << ";" << h.Total() << ";" << events[op] << ";" << h.Percentile(0.5) << ";"
+		          << h.Percentile(0.9) << ";" << h.Percentile(0.99) << ";" << h.Percentile(0.999) << ";"
+		          << h.Max() << '\n';
+	}
+	double recorded = records.empty() ? 0 : records.back().timestamp / 1e9;
+	std::cout << "services;events;recorded_s;replayed_s;events_per_s\n";
+	std::cout << services.size() << ";" << replayed << ";" << recorded << ";" << busy / 1e9 << ";"
+	          << (busy == 0 ? 0 : replayed / (busy / 1e9)) << '\n';
+}
+
 void DifferenceUniformityAbsolute(std::set<IpV6Address>& ipset, std::uint32_t mappings, std::uint32_t cells)
 {
 	std::vector<std::uint32_t> ids(ipset.size(), 0);
@@ -723,6 +1323,11 @@ int main(int argc, char* argv[])
 	std::optional<std::string> config_path;
 	std::size_t cells{DEFAULT_CELLS_PER_WEIGHT};
 	std::size_t mappings{DEFAULT_MAPPINGS};
+	std::string journal_path{DEFAULT_JOURNAL};
+	std::array<std::size_t, 3> mappings_range{DEFAULT_MAPPINGS_RANGE};
+	std::array<std::size_t, 3> cells_range{DEFAULT_CELLS_RANGE};
+	std::size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::optional<std::string> output_path;
 	int i = 1;
 	for (; i < argc - 1; ++i)
 	{
@@ -786,6 +1391,62 @@ int main(int argc, char* argv[])
 				}
 				mappings = std::stoull(std::string(argv[i]));
 				break;
+			case MainArg::JOURNAL:
+				++i;
+				if (i >= argc)
+				{
+					std::cerr << "--journal requires path argument\n";
+					std::exit(EXIT_FAILURE);
+				}
+				journal_path = argv[i];
+				break;
+			case MainArg::MAPPINGS_RANGE:
+			case MainArg::CELLS_RANGE:
+			{
+				bool cells_arg = ParseArg(argv[i]) == MainArg::CELLS_RANGE;
+				++i;
+				if (i >= argc)
+				{
+					std::cerr << argv[i - 1] << " requires min:max:step argument\n";
+					std::exit(EXIT_FAILURE);
+				}
+				if (auto rangearg = ParseRange(std::string{argv[i]}))
+				{
+					(cells_arg ? cells_range : mappings_range) = rangearg.value();
+				}
+				else
+				{
+					std::cerr << "invalid value for " << argv[i - 1] << ", range must be min:max:step\n";
+					std::exit(EXIT_FAILURE);
+				}
+			}
+			break;
+			case MainArg::THREADS:
+				++i;
+				if (i >= argc)
+				{
+					std::cerr << "--threads requires unsigned integer argument\n";
+					std::exit(EXIT_FAILURE);
+				}
+				if (auto threadsarg = ParseUint64(std::string{argv[i]}); threadsarg && threadsarg.value() != 0)
+				{
+					threads = threadsarg.value();
+				}
+				else
+				{
+					std::cerr << "invalid value for --threads\n";
+					std::exit(EXIT_FAILURE);
+				}
+				break;
+			case MainArg::OUTPUT:
+				++i;
+				if (i >= argc)
+				{
+					std::cerr << "--output requires path argument\n";
+					std::exit(EXIT_FAILURE);
+				}
+				output_path = argv[i];
+				break;
 			case MainArg::UNKNOWN:
 				std::cerr << "Unknown argument " << i << " '" << argv[i] << "'\n";
 				std::exit(EXIT_FAILURE);
@@ -835,12 +1496,19 @@ int main(int argc, char* argv[])
 
 	switch (cmd)
 	{
+		case Command::AFFINITY:
+			FlowAffinity(ipset.value(), mappings, cells);
+			break;
+		case Command::ALLOCATIONS:
+			Allocations(ipset.value(), mappings, cells);
+			break;
 		case Command::MAXERRORSERIES:
 		{
 			MaxErrorSeries(10, 300, 100, 20, ipset.value());
 		}
 		break;
 		case Command::MAXERROR:
+			MaxErrorPoint(reals, ids, weights, mappings, cells);
 			break;
 		case Command::OVERLAP:
 			Overlap(ipset.value(), mappings, cells);
@@ -848,6 +1516,18 @@ int main(int argc, char* argv[])
 		case Command::MISSING:
 			Difference(ipset.value(), mappings, cells);
 			break;
+		case Command::RECORD:
+			RecordJournal(ipset.value(), mappings, cells, journal_path);
+			break;
+		case Command::REPLAY:
+			ReplayJournal(mappings, cells, journal_path);
+			break;
+		case Command::SCALING:
+			Scaling(ipset.value(), mappings, cells);
+			break;
+		case Command::SWEEP:
+			Sweep(reals, ids, weights, mappings_range, cells_range, threads, output_path);
+			break;
 		case Command::TIME:
 			Time(ipset.value(), mappings, cells);
 			break;
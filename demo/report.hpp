@@ -2,6 +2,7 @@
 #include <map>
 #include <vector>
 
+#include "analytics.hpp"
 #include "printers.hpp"
 
 namespace report
@@ -21,32 +22,9 @@ void Weights(const std::vector<std::uint32_t>& lookup)
 void Clumps(const std::vector<std::uint32_t>& lookup)
 {
 	std::map<std::uint32_t, std::map<std::size_t, std::size_t>> m;
-	std::size_t start = 1;
-	for (; lookup[start] == lookup[start - 1] && start < lookup.size(); ++start)
+	for (const auto& clump : chash::Clumps(lookup.data(), lookup.size()))
 	{
-	}
-	if (start == lookup.size())
-	{
-		m[lookup[0]][lookup.size()] = 1;
-		Print(m);
-		std::cout << std::endl;
-		return;
-	}
-	std::uint32_t id = lookup[start];
-	std::size_t l{};
-	for (std::size_t i = 0; i < lookup.size(); ++i)
-	{
-		auto curr = lookup[(start + i) % lookup.size()];
-		if (id == curr)
-		{
-			++l;
-		}
-		else
-		{
-			++m[id][l];
-			id = curr;
-			l = 1;
-		}
+		m[clump.id][clump.length] = clump.count;
 	}
 	Print(m);
 	std::cout << std::endl;
@@ -0,0 +1,404 @@
+#include "analytics.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace chash
+{
+
+namespace
+{
+
+// per thread dense counters for ids below, a map for larger ones
+constexpr std::uint32_t DENSE_IDS = 1u << 20;
+// don't start a thread for less
+constexpr std::size_t MIN_CHUNK = 1u << 16;
+
+struct PairHash
+{
+	std::size_t operator()(const std::pair<std::uint32_t, std::size_t>& p) const
+	{
+		return std::hash<std::size_t>{}(p.second * 0x9e3779b97f4a7c15ull ^ p.first);
+	}
+};
+
+using ClumpMap = std::unordered_map<std::pair<std::uint32_t, std::size_t>, std::size_t, PairHash>;
+using CountMap = std::unordered_map<std::uint32_t, std::size_t>;
+
+bool HasAvx2()
+{
+#if defined(__x86_64__)
+	static const bool has = __builtin_cpu_supports("avx2");
+	return has;
+#else
+	return false;
+#endif
+}
+
+std::size_t Threads(std::size_t size, std::size_t threads)
+{
+	if (threads == 0)
+	{
+		threads = size >= PARALLEL_CELLS ? std::max(std::thread::hardware_concurrency(), 1u) : 1;
+	}
+	return std::max<std::size_t>(std::min(threads, size / MIN_CHUNK), 1);
+}
+
+/* @brief Calls \f(part, begin, end) for \parts consecutive chunks of \size
+ * cells, each one on its own thread.
+ */
+template<typename F>
+void Split(std::size_t size, std::size_t parts, F&& f)
+{
+	std::vector<std::thread> workers;
+	for (std::size_t part = 1; part < parts; ++part)
+	{
+		workers.emplace_back(f, part, size * part / parts, size * (part + 1) / parts);
+	}
+	f(0, 0, size / parts);
+	for (auto& w : workers)
+	{
+		w.join();
+	}
+}
+
+std::size_t MismatchesScalar(const std::uint32_t* a, const std::uint32_t* b, std::size_t begin, std::size_t end)
+{
+	std::size_t count{};
+	for (std::size_t i = begin; i < end; ++i)
+	{
+		count += a[i] != b[i];
+	}
+	return count;
+}
+
+std::size_t NextMismatchScalar(const std::uint32_t* a, const std::uint32_t* b, std::size_t from, std::size_t end)
+{
+	while (from < end && a[from] == b[from])
+	{
+		++from;
+	}
+	return from;
+}
+
+std::uint32_t MaxScalar(const std::uint32_t* data, std::size_t begin, std::size_t end)
+{
+	return begin == end ? 0 : *std::max_element(data + begin, data + end);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) std::size_t MismatchesAvx2(const std::uint32_t* a,
+                                                           const std::uint32_t* b,
+                                                           std::size_t begin,
+                                                           std::size_t end)
+{
+	std::size_t equal{};
+	std::size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(va, vb)));
+		equal += __builtin_popcount(mask);
+	}
+	return (i - begin - equal) + MismatchesScalar(a, b, i, end);
+}
+
+__attribute__((target("avx2"))) std::size_t NextMismatchAvx2(const std::uint32_t* a,
+                                                             const std::uint32_t* b,
+                                                             std::size_t from,
+                                                             std::size_t end)
+{
+	for (; from + 8 <= end; from += 8)
+	{
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + from));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + from));
+		unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(va, vb))) ^ 0xffu;
+		if (mask != 0)
+		{
+			return from + __builtin_ctz(mask);
+		}
+	}
+	return NextMismatchScalar(a, b, from, end);
+}
+
+__attribute__((target("avx2"))) std::uint32_t MaxAvx2(const std::uint32_t* data, std::size_t begin, std::size_t end)
+{
+	__m256i max = _mm256_setzero_si256();
+	std::size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		max = _mm256_max_epu32(max, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+	}
+	alignas(32) std::uint32_t lanes[8];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), max);
+	return std::max(*std::max_element(lanes, lanes + 8), MaxScalar(data, i, end));
+}
+#endif
+
+std::size_t Mismatches(const std::uint32_t* a, const std::uint32_t* b, std::size_t begin, std::size_t end)
+{
+#if defined(__x86_64__)
+	if (HasAvx2())
+	{
+		return MismatchesAvx2(a, b, begin, end);
+	}
+#endif
+	return MismatchesScalar(a, b, begin, end);
+}
+
+/* @brief First cell in [\from, \end) where \a and \b differ, \end if none.
+ */
+std::size_t NextMismatch(const std::uint32_t* a, const std::uint32_t* b, std::size_t from, std::size_t end)
+{
+#if defined(__x86_64__)
+	if (HasAvx2())
+	{
+		return NextMismatchAvx2(a, b, from, end);
+	}
+#endif
+	return NextMismatchScalar(a, b, from, end);
+}
+
+/* @brief First cell in [\from, \end) holding another id than the previous
+ * one, \end if none. \from must be positive.
+ */
+std::size_t NextBoundary(const std::uint32_t* data, std::size_t from, std::size_t end)
+{
+	// compares data[i + 1] with data[i], so no pointer before \data is formed
+	return NextMismatch(data + 1, data, from - 1, end - 1) + 1;
+}
+
+std::uint32_t Max(const std::uint32_t* data, std::size_t begin, std::size_t end)
+{
+#if defined(__x86_64__)
+	if (HasAvx2())
+	{
+		return MaxAvx2(data, begin, end);
+	}
+#endif
+	return MaxScalar(data, begin, end);
+}
+
+/* @brief Calls \f(id, begin, end) for every run of equal ids within
+ * [\begin, \end), runs are cut at chunk edges.
+ */
+template<typename F>
+void ForEachRun(const std::uint32_t* data, std::size_t begin, std::size_t end, F&& f)
+{
+	while (begin < end)
+	{
+		std::size_t next = NextBoundary(data, begin + 1, end);
+		f(data[begin], begin, next);
+		begin = next;
+	}
+}
+
+std::vector<std::pair<std::uint32_t, std::size_t>> Sorted(const CountMap& counts)
+{
+	std::vector<std::pair<std::uint32_t, std::size_t>> result(counts.begin(), counts.end());
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+} // namespace
+
+std::size_t CountMismatches(const std::uint32_t* a, const std::uint32_t* b, std::size_t size, std::size_t threads)
+{
+	std::size_t parts = Threads(size, threads);
+	std::vector<std::size_t> counts(parts);
+	Split(size, parts, [&](std::size_t part, std::size_t begin, std::size_t end) {
+		counts[part] = Mismatches(a, b, begin, end);
+	});
+	return std::accumulate(counts.begin(), counts.end(), std::size_t{});
+}
+
+std::vector<std::pair<std::uint32_t, std::size_t>> CellCounts(const std::uint32_t* lookup,
+                                                              std::size_t size,
+                                                              std::size_t threads)
+{
+	std::size_t parts = Threads(size, threads);
+	std::vector<std::uint32_t> maxima(parts);
+	Split(size, parts, [&](std::size_t part, std::size_t begin, std::size_t end) {
+		maxima[part] = Max(lookup, begin, end);
+	});
+	std::uint32_t max = *std::max_element(maxima.begin(), maxima.end());
+
+	if (max < DENSE_IDS)
+	{
+		std::vector<std::vector<std::size_t>> dense(parts);
+		Split(size, parts, [&](std::size_t part, std::size_t begin, std::size_t end) {
+			auto& counts = dense[part];
+			counts.assign(std::size_t{max} + 1, 0);
+			ForEachRun(lookup, begin, end, [&](std::uint32_t id, std::size_t first, std::size_t last) {
+				counts[id] += last - first;
+			});
+		});
+		std::vector<std::pair<std::uint32_t, std::size_t>> result;
+		for (std::uint32_t id = 0; id <= max; ++id)
+		{
+			std::size_t count{};
+			for (const auto& counts : dense)
+			{
+				count += counts[id];
+			}
+			if (count != 0)
+			{
+				result.emplace_back(id, count);
+			}
+		}
+		return result;
+	}
+
+	std::vector<CountMap> maps(parts);
+	Split(size, parts, [&](std::size_t part, std::size_t begin, std::size_t end) {
+		ForEachRun(lookup, begin, end, [&](std::uint32_t id, std::size_t first, std::size_t last) {
+			maps[part][id] += last - first;
+		});
+	});
+	for (std::size_t part = 1; part < parts; ++part)
+	{
+		for (const auto& [id, count] : maps[part])
+		{
+			maps[0][id] += count;
+		}
+	}
+	return Sorted(maps[0]);
+}
+
+std::vector<std::pair<std::uint32_t, std::size_t>> MovedCells(const std::uint32_t* from,
+                                                              const std::uint32_t* to,
+                                                              std::size_t size,
+                                                              std::size_t threads)
+{
+	std::size_t parts = Threads(size, threads);
+	std::vector<CountMap> maps(parts);
+	Split(size, parts, [&](std::size_t part, std::size_t begin, std::size_t end) {
+		for (std::size_t i = NextMismatch(from, to, begin, end); i < end; i = NextMismatch(from, to, i + 1, end))
+		{
+			++maps[part][to[i]];
+		}
+	});
+	for (std::size_t part = 1; part < parts; ++part)
+	{
+		for (const auto& [id, count] : maps[part])
+		{
+			maps[0][id] += count;
+		}
+	}
+	return Sorted(maps[0]);
+}
+
+std::vector<Clump> Clumps(const std::uint32_t* lookup, std::size_t size, std::size_t threads)
+{
+	struct Run
+	{
+		std::uint32_t id;
+		std::size_t length;
+	};
+	// runs touching chunk edges are joined with neighbours afterwards
+	struct Chunk
+	{
+		Run first{};
+		Run last{};
+		bool whole = true;
+		ClumpMap inner;
+	};
+
+	if (size == 0)
+	{
+		return {};
+	}
+
+	std::size_t parts = Threads(size, threads);
+	std::vector<Chunk> chunks(parts);
+	Split(size, parts, [&](std::size_t part, std::size_t begin, std::size_t end) {
+		Chunk& chunk = chunks[part];
+		ForEachRun(lookup, begin, end, [&](std::uint32_t id, std::size_t first, std::size_t last) {
+			Run run{id, last - first};
+			if (first == begin)
+			{
+				chunk.first = run;
+			}
+			else
+			{
+				if (!chunk.whole)
+				{
+					++chunk.inner[{chunk.last.id, chunk.last.length}];
+				}
+				chunk.whole = false;
+			}
+			chunk.last = run;
+		});
+	});
+
+	ClumpMap clumps;
+	std::optional<Run> head;
+	Run open = chunks[0].first;
+	auto close = [&](const Run& run) {
+		if (!head)
+		{
+			head = run;
+			return;
+		}
+		++clumps[{run.id, run.length}];
+	};
+	for (std::size_t part = 0; part < parts; ++part)
+	{
+		Chunk& chunk = chunks[part];
+		if (part != 0)
+		{
+			if (chunk.first.id == open.id)
+			{
+				open.length += chunk.first.length;
+			}
+			else
+			{
+				close(open);
+				open = chunk.first;
+			}
+		}
+		if (!chunk.whole)
+		{
+			close(open);
+			for (const auto& [run, count] : chunk.inner)
+			{
+				clumps[run] += count;
+			}
+			open = chunk.last;
+		}
+	}
+	if (!head)
+	{
+		++clumps[{open.id, size}];
+	}
+	else if (head->id == open.id)
+	{
+		++clumps[{open.id, open.length + head->length}];
+	}
+	else
+	{
+		++clumps[{head->id, head->length}];
+		++clumps[{open.id, open.length}];
+	}
+
+	std::vector<Clump> result;
+	result.reserve(clumps.size());
+	for (const auto& [run, count] : clumps)
+	{
+		result.push_back(Clump{run.first, run.second, count});
+	}
+	std::sort(result.begin(), result.end(), [](const Clump& a, const Clump& b) {
+		return std::pair(a.id, a.length) < std::pair(b.id, b.length);
+	});
+	return result;
+}
+
+} // namespace chash
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace chash
+{
+
+/* @brief Quality checks of lookups of 32-bit real ids, e.g. after every
+ * update. Kernels use AVX2 when the CPU has it and split tables of at least
+ * PARALLEL_CELLS cells among threads. \threads of 0 picks
+ * std::thread::hardware_concurrency() for large tables and one thread for
+ * smaller ones. Results do not depend on the number of threads.
+ */
+constexpr std::size_t PARALLEL_CELLS = std::size_t{1} << 20;
+
+/* @brief Number of cells of \a and \b, both of \size cells, holding
+ * different ids.
+ */
+std::size_t CountMismatches(const std::uint32_t* a, const std::uint32_t* b, std::size_t size, std::size_t threads = 0);
+
+/* @brief Cells per id of \lookup as (id, cells) sorted by id.
+ */
+std::vector<std::pair<std::uint32_t, std::size_t>> CellCounts(const std::uint32_t* lookup,
+                                                              std::size_t size,
+                                                              std::size_t threads = 0);
+
+/* @brief Cells per new owner among the cells of \to which differ from
+ * \from, as (id in \to, cells) sorted by id.
+ */
+std::vector<std::pair<std::uint32_t, std::size_t>> MovedCells(const std::uint32_t* from,
+                                                              const std::uint32_t* to,
+                                                              std::size_t size,
+                                                              std::size_t threads = 0);
+
+/* @brief \count runs of \length equal \id cells in a row.
+ */
+struct Clump
+{
+	std::uint32_t id;
+	std::size_t length;
+	std::size_t count;
+};
+
+/* @brief Histogram of runs of equal ids in \lookup taken as a ring, i.e. a
+ * run may wrap from the last cell to the first one, sorted by id and length.
+ */
+std::vector<Clump> Clumps(const std::uint32_t* lookup, std::size_t size, std::size_t threads = 0);
+
+} // namespace chash
@@ -0,0 +1,353 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory_resource>
+#include <vector>
+
+#include "common.hpp"
+
+namespace chash
+{
+
+/* @brief Binary heap of item indices with the position of every item kept,
+ * so an item whose key has changed is sifted from where it is. \Before
+ * orders keys, the root is the first one.
+ */
+template<typename Before>
+class BasicKeyHeap
+{
+	static constexpr std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+
+	std::pmr::vector<std::uint32_t> items_;
+	std::pmr::vector<std::uint32_t> positions_;
+
+	void Place(std::size_t pos, std::uint32_t item)
+	{
+		items_[pos] = item;
+		positions_[item] = pos;
+	}
+
+	template<typename Key>
+	void Up(std::size_t pos, const Key& key)
+	{
+		std::uint32_t item = items_[pos];
+		for (; pos > 0 && Before{}(key(item), key(items_[(pos - 1) / 2])); pos = (pos - 1) / 2)
+		{
+			Place(pos, items_[(pos - 1) / 2]);
+		}
+		Place(pos, item);
+	}
+
+	template<typename Key>
+	void Down(std::size_t pos, const Key& key)
+	{
+		std::uint32_t item = items_[pos];
+		for (std::size_t child; (child = 2 * pos + 1) < items_.size(); pos = child)
+		{
+			if (child + 1 < items_.size() && Before{}(key(items_[child + 1]), key(items_[child])))
+			{
+				++child;
+			}
+			if (!Before{}(key(items_[child]), key(item)))
+			{
+				break;
+			}
+			Place(pos, items_[child]);
+		}
+		Place(pos, item);
+	}
+
+public:
+	explicit BasicKeyHeap(std::pmr::memory_resource* resource) :
+	        items_(resource),
+	        positions_(resource)
+	{
+	}
+
+	void Reset(std::size_t items)
+	{
+		items_.clear();
+		items_.reserve(items);
+		positions_.assign(items, NONE);
+	}
+
+	/* @brief Puts \item in place after its key(item) has changed, inserts
+	 * it if absent. Removes it if \present is false.
+	 */
+	template<typename Key>
+	void Update(std::uint32_t item, bool present, const Key& key)
+	{
+		std::uint32_t pos = positions_[item];
+		if (!present)
+		{
+			if (pos == NONE)
+			{
+				return;
+			}
+			std::uint32_t last = items_.back();
+			items_.pop_back();
+			positions_[item] = NONE;
+			if (pos < items_.size())
+			{
+				Place(pos, last);
+				Up(pos, key);
+				Down(positions_[last], key);
+			}
+			return;
+		}
+		if (pos == NONE)
+		{
+			items_.push_back(item);
+			Up(items_.size() - 1, key);
+			return;
+		}
+		Up(pos, key);
+		Down(positions_[item], key);
+	}
+
+	bool Empty() const
+	{
+		return items_.empty();
+	}
+
+	std::uint32_t Top() const
+	{
+		return items_.front();
+	}
+};
+
+/* @brief Cells held by every real in the lookup of an updater, kept up to
+ * date while slices are painted once Start is called. Reals with enabled
+ * heads are also kept in two heaps by cells per enabled head, their roots
+ * give the worst weight error, so neither query scans the lookup. Until
+ * Start every call is a single branch.
+ */
+template<typename Config>
+class BasicBalance
+{
+public:
+	using Index = typename Config::Index;
+	using RealId = typename Config::RealId;
+
+private:
+	struct Entry
+	{
+		RealId id{};
+		std::size_t cells{};
+		Index enabled{};
+		// as of the last Settle
+		Index settled{};
+		double ratio{};
+		bool dirty{};
+	};
+
+	std::pmr::vector<Entry> entries_;
+	// open addressing index of entries_ (position + 1, 0 is empty), it is
+	// probed for every painted slice, where std::unordered_map costs more
+	// than a short walk
+	std::pmr::vector<std::uint32_t> slots_;
+	unsigned shift_{63};
+	BasicKeyHeap<std::greater<double>> most_;
+	BasicKeyHeap<std::less<double>> least_;
+	std::pmr::vector<std::uint32_t> dirty_;
+	std::size_t enabled_{};
+	std::size_t size_{};
+	bool active_{};
+
+	std::size_t Slot(RealId id) const
+	{
+		return (static_cast<std::uint64_t>(id) * 0x9e3779b97f4a7c15ull) >> shift_;
+	}
+
+	Entry* Find(RealId id)
+	{
+		for (std::size_t slot = Slot(id);; slot = (slot + 1) & (slots_.size() - 1))
+		{
+			if (slots_[slot] == 0)
+			{
+				return nullptr;
+			}
+			if (Entry& entry = entries_[slots_[slot] - 1]; entry.id == id)
+			{
+				return &entry;
+			}
+		}
+	}
+
+	const Entry* Find(RealId id) const
+	{
+		return const_cast<BasicBalance*>(this)->Find(id);
+	}
+
+	void Touch(Entry& entry)
+	{
+		if (!entry.dirty)
+		{
+			entry.dirty = true;
+			dirty_.push_back(&entry - entries_.data());
+		}
+	}
+
+public:
+	explicit BasicBalance(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+	        entries_(resource),
+	        slots_(1, 0, resource),
+	        most_(resource),
+	        least_(resource),
+	        dirty_(resource)
+	{
+	}
+
+	bool Active() const
+	{
+		return active_;
+	}
+
+	/* @brief Starts counting from zero, \heads are reals of the updater and
+	 * \size is the lookup size. Cells of the current lookup are to be added.
+	 */
+	template<typename Heads>
+	void Start(const Heads& heads, std::size_t size)
+	{
+		active_ = true;
+		entries_.clear();
+		dirty_.clear();
+		enabled_ = 0;
+		size_ = size;
+
+		unsigned bits = 1;
+		while ((std::size_t{1} << bits) < 2 * heads.size())
+		{
+			++bits;
+		}
+		shift_ = 64 - bits;
+		slots_.assign(std::size_t{1} << bits, 0);
+		entries_.reserve(heads.size());
+		for (const auto& [id, info] : heads)
+		{
+			entries_.push_back(Entry{id, 0, info.enabled});
+			std::size_t slot = Slot(id);
+			while (slots_[slot] != 0)
+			{
+				slot = (slot + 1) & (slots_.size() - 1);
+			}
+			slots_[slot] = entries_.size();
+			Touch(entries_.back());
+		}
+		most_.Reset(entries_.size());
+		least_.Reset(entries_.size());
+	}
+
+	void Stop()
+	{
+		*this = BasicBalance(entries_.get_allocator().resource());
+	}
+
+	void Add(RealId id, std::size_t cells)
+	{
+		if (!active_)
+		{
+			return;
+		}
+		if (Entry* entry = Find(id))
+		{
+			entry->cells += cells;
+			Touch(*entry);
+		}
+	}
+
+	/* @brief \cells cells of \from are repainted with \to, ids unknown to
+	 * the updater, e.g. Invalid(), are not counted.
+	 */
+	void Move(RealId from, RealId to, std::size_t cells)
+	{
+		if (!active_ || cells == 0)
+		{
+			return;
+		}
+		if (Entry* entry = Find(from))
+		{
+			entry->cells -= cells;
+			Touch(*entry);
+		}
+		Add(to, cells);
+	}
+
+	// whole lookup is painted with \id
+	void Fill(RealId id)
+	{
+		if (!active_)
+		{
+			return;
+		}
+		for (Entry& entry : entries_)
+		{
+			entry.cells = 0;
+			Touch(entry);
+		}
+		Add(id, size_);
+	}
+
+	void Enabled(RealId id, Index enabled)
+	{
+		if (!active_)
+		{
+			return;
+		}
+		if (Entry* entry = Find(id); entry != nullptr && entry->enabled != enabled)
+		{
+			entry->enabled = enabled;
+			Touch(*entry);
+		}
+	}
+
+	/* @brief Reorders reals changed since the last call.
+	 */
+	void Settle()
+	{
+		auto key = [this](std::uint32_t item) {
+			return entries_[item].ratio;
+		};
+		for (std::uint32_t item : dirty_)
+		{
+			Entry& entry = entries_[item];
+			enabled_ = enabled_ - entry.settled + entry.enabled;
+			entry.settled = entry.enabled;
+			entry.ratio = entry.enabled == 0 ? 0 : static_cast<double>(entry.cells) / entry.enabled;
+			most_.Update(item, entry.enabled != 0, key);
+			least_.Update(item, entry.enabled != 0, key);
+			entry.dirty = false;
+		}
+		dirty_.clear();
+	}
+
+	std::size_t Cells(RealId id) const
+	{
+		const Entry* entry = Find(id);
+		return entry == nullptr ? 0 : entry->cells;
+	}
+
+	double Share(RealId id) const
+	{
+		return size_ == 0 ? 0 : static_cast<double>(Cells(id)) / size_;
+	}
+
+	/* @brief max |share - requested| / requested over reals with enabled
+	 * heads, requested share being enabled heads of the real over all.
+	 */
+	double MaxError() const
+	{
+		if (most_.Empty())
+		{
+			return 0;
+		}
+		double scale = static_cast<double>(enabled_) / size_;
+		return std::max(std::abs(entries_[most_.Top()].ratio * scale - 1),
+		                std::abs(entries_[least_.Top()].ratio * scale - 1));
+	}
+};
+
+} // namespace chash
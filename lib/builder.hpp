@@ -0,0 +1,134 @@
+#pragma once
+#include <limits>
+#include <memory_resource>
+#include <optional>
+
+#include "chash.hpp"
+
+namespace chash
+{
+
+/* @brief Builds updaters one after another reusing the same temporaries.
+ * Scratch buffers grow to the largest service built so far and are never
+ * released, so in steady state construction allocates nothing but the
+ * resulting updater. Results are the same as of MakeWeightUpdater.
+ * A builder must not be used by two threads at once.
+ */
+template<typename Config = DefaultConfig>
+class BasicUpdaterBuilder
+{
+public:
+	using Updater = BasicWeightUpdater<Config>;
+	using Scratch = BasicMakerScratch<Config>;
+	using Index = typename Config::Index;
+	using RealId = typename Config::RealId;
+	using Weight = typename Config::Weight;
+
+	template<typename Real>
+	using Maker = BasicUpdaterMaker<Config, Real>;
+
+private:
+	Scratch scratch_;
+
+public:
+	/* @brief Scratch buffers are allocated from \resource.
+	 */
+	explicit BasicUpdaterBuilder(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+	        scratch_(resource)
+	{
+	}
+
+	BasicUpdaterBuilder(const BasicUpdaterBuilder&) = delete;
+	BasicUpdaterBuilder& operator=(const BasicUpdaterBuilder&) = delete;
+
+	/* @brief Same as BasicWeightUpdater::MakeWeightUpdater, the updater is
+	 * allocated from \resource. Side rings are taken from and put to \cache
+	 * if it is given.
+	 */
+	template<typename Real>
+	std::optional<Updater> MakeWeightUpdater(
+	        const Real* reals,
+	        const RealId* ids,
+	        const Weight* weights,
+	        Index cnt,
+	        Index side_rings_count,
+	        Index segments_per_weight,
+	        Index lookup_size,
+	        std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+	        BasicRingCache<Real, Config>* cache = nullptr)
+	{
+		auto maker = MakeMaker(reals,
+		                       ids,
+		                       weights,
+		                       cnt,
+		                       side_rings_count,
+		                       segments_per_weight,
+		                       lookup_size,
+		                       resource,
+		                       cache);
+		while (!maker.Finished())
+		{
+			maker.Step(std::numeric_limits<std::size_t>::max());
+		}
+		return maker.Result();
+	}
+
+	template<typename Real>
+	std::optional<Updater> MakeWeightUpdater(
+	        const Real* reals,
+	        const RealId* ids,
+	        const Weight* weights,
+	        Index cnt,
+	        Index side_rings_count,
+	        Index segments_per_weight)
+	{
+		return MakeWeightUpdater(reals,
+		                         ids,
+		                         weights,
+		                         cnt,
+		                         side_rings_count,
+		                         segments_per_weight,
+		                         Updater::LookupRequiredSize(cnt, segments_per_weight));
+	}
+
+	/* @brief Frees scratch buffers, e.g. after building an unusually big
+	 * service. Side rings alone take Config::DEFAULT_UNWEIGHTED_SIZE cells
+	 * each.
+	 */
+	void Release()
+	{
+		scratch_ = Scratch(scratch_.Resource());
+	}
+
+	/* @brief Returns stepwise maker borrowing the scratch of the builder.
+	 * Only one maker of a builder may exist at a time.
+	 */
+	template<typename Real>
+	Maker<Real> MakeMaker(
+	        const Real* reals,
+	        const RealId* ids,
+	        const Weight* weights,
+	        Index cnt,
+	        Index side_rings_count,
+	        Index segments_per_weight,
+	        Index lookup_size,
+	        std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+	        BasicRingCache<Real, Config>* cache = nullptr)
+	{
+		Maker<Real> maker(reals,
+		                  ids,
+		                  weights,
+		                  cnt,
+		                  side_rings_count,
+		                  segments_per_weight,
+		                  lookup_size,
+		                  scratch_,
+		                  resource);
+		maker.SetRingCache(cache);
+		return maker;
+	}
+};
+
+using UpdaterBuilder = BasicUpdaterBuilder<DefaultConfig>;
+
+} // namespace chash
@@ -1,14 +1,24 @@
 #pragma once
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
+#include <optional>
 #include <random>
+#include <set>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "balance.hpp"
 #include "bit-reverse.hpp"
 #include "common.hpp"
+#include "positions.hpp"
+#include "rings.hpp"
 #include "unweighted.hpp"
 #include "utils.hpp"
 
@@ -26,33 +36,139 @@ struct BasicRealConfig
 template<typename Config>
 struct BasicRealInfo
 {
-	std::vector<typename Config::Index> heads;
+	using allocator_type = std::pmr::polymorphic_allocator<typename Config::Index>;
+
+	std::pmr::vector<typename Config::Index> heads;
 	typename Config::Index enabled = 0;
+
+	BasicRealInfo() = default;
+
+	explicit BasicRealInfo(const allocator_type& allocator) :
+	        heads(allocator)
+	{
+	}
+
+	BasicRealInfo(const BasicRealInfo& other, const allocator_type& allocator) :
+	        heads(other.heads, allocator),
+	        enabled{other.enabled}
+	{
+	}
+
+	BasicRealInfo(BasicRealInfo&& other, const allocator_type& allocator) :
+	        heads(std::move(other.heads), allocator),
+	        enabled{other.enabled}
+	{
+	}
+};
+
+/* @brief Run of \count lookup cells starting at \start painted with \id.
+ * All of them held \was before.
+ */
+template<typename Config>
+struct BasicSlice
+{
+	typename Config::Index start;
+	typename Config::Index count;
+	typename Config::RealId id;
+	typename Config::RealId was;
+};
+
+/* @brief Outcome of a weight change computed without applying it, see
+ * BasicWeightUpdater::EstimateDisruption. \donors lose and \receivers gain
+ * \moved cells in total, both as (id, cells) sorted by id. Invalid() stands
+ * for cells of a lookup with no enabled reals.
+ */
+template<typename Config>
+struct BasicDisruption
+{
+	std::size_t moved{};
+	std::vector<std::pair<typename Config::RealId, std::size_t>> donors;
+	std::vector<std::pair<typename Config::RealId, std::size_t>> receivers;
 };
 
+/* @brief Receives weight changes passed to public methods of
+ * BasicWeightUpdater before they are applied, see SetRecorder and
+ * BasicJournalWriter. May be called from several updaters at once.
+ */
+template<typename Config>
+class BasicRecorder
+{
+public:
+	virtual ~BasicRecorder() = default;
+
+	virtual void Record(std::uint32_t service,
+	                    Operation op,
+	                    const typename Config::RealId* ids,
+	                    const typename Config::Weight* weights,
+	                    typename Config::Index count) = 0;
+};
+
+template<typename Config, typename Real>
+class BasicUpdaterMaker;
+
+template<typename Config>
+class BasicSnapshot;
+
+template<typename Config>
+class BasicSharedUpdater;
+
 template<typename Config = DefaultConfig>
 class BasicWeightUpdater
 {
+	template<typename, typename>
+	friend class BasicUpdaterMaker;
+	friend class BasicSnapshot<Config>;
+	friend class BasicSharedUpdater<Config>;
+
 public:
 	using Index = typename Config::Index;
 	using RealId = typename Config::RealId;
 	using Weight = typename Config::Weight;
 	using RealInfo = BasicRealInfo<Config>;
+	using Slice = BasicSlice<Config>;
+	using Stats = typename Config::Stats;
+	using Recorder = BasicRecorder<Config>;
+	using Disruption = BasicDisruption<Config>;
 
 private:
 	Index segments_per_weight_;
-	std::unordered_map<RealId, RealInfo> heads_;
-	std::vector<bool> enabled_;
+	std::pmr::unordered_map<RealId, RealInfo> heads_;
+	std::pmr::vector<bool> enabled_;
 	Index lookup_size_;
 	Index active_ = 0;
-	BasicWeightUpdater(Index segments_per_weight, std::size_t lookup_size) :
+	// set only while an update records painted slices
+	std::pmr::vector<Slice>* changes_{};
+	mutable Stats stats_;
+	// off until TrackBalance, InitLookup is const and recounts
+	mutable BasicBalance<Config> balance_;
+	Recorder* recorder_{};
+	std::uint32_t service_{};
+	// undo log of the open transaction, see Begin
+	std::pmr::vector<Slice> undo_cells_;
+	std::pmr::vector<std::pair<RealId, Index>> undo_heads_;
+	Index undo_active_{};
+	bool transaction_{};
+	BasicWeightUpdater(Index segments_per_weight,
+	                   std::size_t lookup_size,
+	                   std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
 	        segments_per_weight_{segments_per_weight},
-	        enabled_(lookup_size, false),
-	        lookup_size_(lookup_size)
+	        heads_(resource),
+	        enabled_(lookup_size, false, resource),
+	        lookup_size_(lookup_size),
+	        balance_(resource),
+	        undo_cells_(resource),
+	        undo_heads_(resource)
 	{
 	}
 
 public:
+	/* @brief Memory resource all containers of the updater allocate from.
+	 */
+	std::pmr::memory_resource* Resource() const
+	{
+		return heads_.get_allocator().resource();
+	}
+
 	Index LookupSize() const
 	{
 		return lookup_size_;
@@ -71,147 +187,89 @@ public:
 	        Index cnt,
 	        Index side_rings_count,
 	        Index segments_per_weight,
-	        Index lookup_size)
+	        Index lookup_size,
+	        std::pmr::memory_resource* resource = std::pmr::get_default_resource())
 	{
-		if (cnt == 0 ||
-		    side_rings_count + segments_per_weight * Config::MaxWeight == 0 ||
-		    side_rings_count < 1 ||
-		    lookup_size < segments_per_weight * Config::MaxWeight)
+		BasicUpdaterMaker<Config, Real> maker(reals,
+		                                      ids,
+		                                      weights,
+		                                      cnt,
+		                                      side_rings_count,
+		                                      segments_per_weight,
+		                                      lookup_size,
+		                                      resource);
+		while (!maker.Finished())
 		{
-			return std::nullopt;
-		}
-		BasicWeightUpdater updater(segments_per_weight, lookup_size);
-		for (Index i = 0; i < cnt; ++i)
-		{
-			RealInfo& info = updater.heads_[ids[i]];
-			info.enabled = weights[i] * segments_per_weight;
-			if (info.enabled != 0)
-			{
-				++updater.active_;
-			}
+			maker.Step(std::numeric_limits<std::size_t>::max());
 		}
+		return maker.Result();
+	}
 
-		std::vector<Unweighted<RealId>> unweighted;
-
-		std::mt19937 seq(Config::RNG_SEED);
-		std::set<RealId> unseen{ids, ids + cnt};
-		std::set<RealId> remain;
-		for (std::size_t i = 0; i < side_rings_count; ++i)
+private:
+	/* @brief Paints cells starting at \start with \id until an enabled cell
+	 * or a cell of another color. Walk is split at the end of \ring into two
+	 * linear runs, so no wrap-around arithmetic is done per cell.
+	 */
+	template<typename Ring>
+	void ColorSlice(RealId id, Index start, RealId* lookup, const Ring& ring)
+	{
+		RealId tint = lookup[start];
+		if (tint == id)
 		{
-			auto salt = seq();
-			auto [ring, contain] = Unweighted<RealId>::Make(reals, ids, cnt, salt, Config::DEFAULT_UNWEIGHTED_SIZE);
-			unweighted.emplace_back(std::move(ring));
-			remain.clear();
-			for (auto id : unseen)
-			{
-				if (contain.find(id) == contain.end())
-				{
-					remain.insert(id);
-				}
-			}
-			unseen = std::move(remain);
+			return;
 		}
-
-		if (!unseen.empty())
+		std::size_t i{start};
+		for (std::size_t end = ring.Size(); i < end && lookup[i] == tint && !enabled_[i]; ++i)
 		{
-			// unweighted rings don't contain some reals due to collisions
-			return std::nullopt;
+			lookup[i] = id;
 		}
-
-		std::uint8_t lookup_bits = PowerOfTwoLowerBound(lookup_size);
-		std::size_t u{};
-		Index distributed{};
-		Index need_heads = LookupRequiredSize(cnt, segments_per_weight);
-		for (Index i = 0, pos = 0; distributed < need_heads; ++i, pos = ReverseBits(lookup_bits, i))
+		Record(start, i - start, id, tint);
+		balance_.Move(tint, id, i - start);
+		if (i != ring.Size())
 		{
-			if (pos >= lookup_size)
-			{
-				continue;
-			}
-
-			RealId rid = unweighted[u].Match(seq());
-			updater.heads_[rid].heads.push_back(pos);
-			u = NextRingPosition(unweighted.size(), u);
-			updater.enabled_[pos] = true;
-			++distributed;
-
-			if (distributed % (segments_per_weight * cnt) == 0)
-			{
-				updater.Rebalance(distributed / updater.heads_.size());
-			}
+			stats_.Walk(i - start);
+			return;
 		}
-
-		for (auto& [id, info] : updater.heads_)
+		for (i = 0; i < start && lookup[i] == tint && !enabled_[i]; ++i)
 		{
-			GCC_BUG_UNUSED(id);
-			std::for_each(info.heads.begin() + info.enabled,
-			              info.heads.end(),
-			              [&](const Index pos) {
-				              updater.enabled_[pos] = false;
-			              });
+			lookup[i] = id;
 		}
-		return updater;
+		Record(0, i, id, tint);
+		balance_.Move(tint, id, i);
+		stats_.Walk(ring.Size() - start + i);
 	}
 
-private:
-	void Rebalance(Index target)
+	template<typename Ring>
+	void FillLookup(RealId id, RealId* lookup, const Ring& ring)
 	{
-		std::vector<RealId> low;
-		std::vector<RealId> high;
-		for (auto& [id, info] : heads_)
-		{
-			if (info.heads.size() > target)
-			{
-				high.emplace_back(id);
-			}
-			else if (info.heads.size() < target)
-			{
-				low.emplace_back(id);
-			}
-		}
-
-		if (low.empty() || high.empty())
+		if (changes_ != nullptr || transaction_)
 		{
-			return;
-		}
-
-		auto l = low.begin();
-		auto h = high.begin();
-		while (l != low.end())
-		{
-
-			heads_.at(*l).heads.push_back(heads_.at(*h).heads.back());
-			heads_.at(*h).heads.pop_back();
-
-			if (heads_.at(*l).heads.size() == target)
+			// one slice per run of the previous contents
+			for (Index i = 0, run = 0; i < ring.Size(); i = run)
 			{
-				++l;
-				if (l == low.end())
+				for (run = i; run < ring.Size() && lookup[run] == lookup[i]; ++run)
 				{
-					break;
-				}
-			}
-			if (heads_.at(*h).heads.size() == target)
-			{
-				++h;
-				if (h == high.end())
-				{
-					break;
 				}
+				Record(i, run - i, id, lookup[i]);
 			}
 		}
+		std::fill(lookup, lookup + ring.Size(), id);
+		balance_.Fill(id);
 	}
 
-	void ColorSlice(RealId id, Index start, RealId* lookup)
+	void Record(Index start, Index count, RealId id, RealId was)
 	{
-		RealId tint = lookup[start];
-		if (tint == id)
+		if (count == 0 || id == was)
 		{
 			return;
 		}
-		for (std::size_t i{start}; lookup[i] == tint && !enabled_[i]; i = NextRingPosition(LookupSize(), i))
+		if (changes_ != nullptr)
 		{
-			lookup[i] = id;
+			changes_->push_back(Slice{start, count, id, was});
+		}
+		if (transaction_)
+		{
+			undo_cells_.push_back(Slice{start, count, id, was});
 		}
 	}
 
@@ -222,23 +280,26 @@ private:
 	 * fact that such occurances are comparatively rare and the lower the
 	 * target weight the rarer they become.
 	 */
-	void DisableSlice(RealId id, RealId* lookup)
+	template<typename Ring>
+	void DisableSlice(RealId id, RealId* lookup, const Ring& ring)
 	{
 		auto& donor = heads_.at(id);
 		--donor.enabled;
+		stats_.SliceDisabled();
 
 		Index disable = donor.heads.at(donor.enabled);
-		RealId shadow = lookup[PrevRingPosition(lookup_size_, disable)];
+		RealId shadow = lookup[ring.Prev(disable)];
 
 		enabled_[disable] = false;
-		ColorSlice(shadow, disable, lookup);
+		ColorSlice(shadow, disable, lookup, ring);
 	}
 
 	/* @brief Marks the cell in chain of head cells for \id directly past the
 	 * last enabled as enabled and adds new slice starting at corresponding
 	 * position.
 	 */
-	void EnableSlice(RealId id, RealId* lookup)
+	template<typename Ring>
+	void EnableSlice(RealId id, RealId* lookup, const Ring& ring)
 	{
 		auto& receiver = heads_.at(id);
 		if (receiver.enabled == receiver.heads.size())
@@ -248,30 +309,23 @@ private:
 
 		if (Disabled())
 		{
-			std::fill(lookup, lookup + lookup_size_, id);
+			FillLookup(id, lookup, ring);
 			enabled_[receiver.heads[0]] = true;
 			++receiver.enabled;
 			return;
 		}
 
-		if ((active_ == 1) && (*lookup == id))
-		{
-			++receiver.enabled;
-			return;
-		}
-
 		Index start = receiver.heads[receiver.enabled];
-		ColorSlice(id, start, lookup);
+		ColorSlice(id, start, lookup, ring);
 		enabled_[start] = true;
+		stats_.SliceEnabled();
 
 		++receiver.enabled;
 	}
 
-public:
-	/* @brief disables/enables \id slices one by one until the /weight requirement
-	 * is met
-	 */
-	void UpdateWeight(RealId id, Weight weight, RealId* lookup)
+protected:
+	template<typename Ring>
+	void UpdateWeight(RealId id, Weight weight, RealId* lookup, const Ring& ring)
 	{
 		if (heads_.find(id) == heads_.end())
 		{
@@ -280,15 +334,19 @@ public:
 		auto& info = heads_.at(id);
 
 		Index was = info.enabled;
+		if (transaction_ && was != weight * segments_per_weight_)
+		{
+			undo_heads_.emplace_back(id, was);
+		}
 
 		while (info.enabled > weight * segments_per_weight_)
 		{
-			DisableSlice(id, lookup);
+			DisableSlice(id, lookup, ring);
 		}
 
 		while (info.enabled < weight * segments_per_weight_)
 		{
-			EnableSlice(id, lookup);
+			EnableSlice(id, lookup, ring);
 		}
 
 		if (was == 0 && weight != 0)
@@ -300,13 +358,47 @@ public:
 			--active_;
 			if (active_ == 0)
 			{
-				std::fill(lookup, lookup + lookup_size_, Invalid());
+				FillLookup(Invalid(), lookup, ring);
 			}
 		}
+		balance_.Enabled(id, info.enabled);
+	}
+
+	/* @brief Public UpdateWeight and UpdateLookup walking \lookup with
+	 * \ring: records the call, reports its latency as \op and settles
+	 * balance of touched reals.
+	 */
+	template<typename Ring>
+	void Update(Operation op, const RealId* ids, const Weight* weights, Index count, RealId* lookup, const Ring& ring)
+	{
+		ScopedLatency latency(stats_, op);
+		if (recorder_ != nullptr)
+		{
+			recorder_->Record(service_, op, ids, weights, count);
+		}
+		for (Index i = 0; i < count; ++i)
+		{
+			UpdateWeight(ids[i], weights[i], lookup, ring);
+		}
+		balance_.Settle();
+	}
+
+public:
+	/* @brief disables/enables \id slices one by one until the /weight requirement
+	 * is met
+	 */
+	void UpdateWeight(RealId id, Weight weight, RealId* lookup)
+	{
+		Update(Operation::UPDATE_WEIGHT, &id, &weight, 1, lookup, DynamicRing{lookup_size_});
 	}
 
 	void SetWeights(const RealId* ids, const Weight* weights, Index count)
 	{
+		ScopedLatency latency(stats_, Operation::SET_WEIGHTS);
+		if (recorder_ != nullptr)
+		{
+			recorder_->Record(service_, Operation::SET_WEIGHTS, ids, weights, count);
+		}
 		for (Index i = 0; i < count; ++i)
 		{
 			if (auto h = heads_.find(ids[i]); h != heads_.end())
@@ -321,6 +413,10 @@ public:
 				}
 				Index& current = h->second.enabled;
 				Index updated = weights[i] * segments_per_weight_;
+				if (transaction_ && current != updated)
+				{
+					undo_heads_.emplace_back(ids[i], current);
+				}
 				if (updated > current)
 				{
 					std::for_each(h->second.heads.begin() + current,
@@ -331,8 +427,8 @@ public:
 				}
 				else
 				{
-					std::for_each(h->second.heads.begin() + current,
-					              h->second.heads.begin() + updated,
+					std::for_each(h->second.heads.begin() + updated,
+					              h->second.heads.begin() + current,
 					              [&](Index pos) {
 						              enabled_[pos] = false;
 					              });
@@ -344,10 +440,141 @@ public:
 
 	void UpdateLookup(const RealId* ids, const Weight* weights, Index count, RealId* lookup)
 	{
-		for (Index i = 0; i < count; ++i)
+		Update(Operation::UPDATE_LOOKUP, ids, weights, count, lookup, DynamicRing{lookup_size_});
+	}
+
+	/* @brief Same as above and appends every run of cells painted in
+	 * \lookup to \changes, in order. Other copies of the lookup are brought
+	 * up to date by ApplyChanges without comparing or copying whole lookups.
+	 */
+	void UpdateLookup(const RealId* ids,
+	                  const Weight* weights,
+	                  Index count,
+	                  RealId* lookup,
+	                  std::pmr::vector<Slice>& changes)
+	{
+		changes_ = &changes;
+		UpdateLookup(ids, weights, count, lookup);
+		changes_ = nullptr;
+	}
+
+	static void ApplyChanges(const Slice* changes, std::size_t count, RealId* lookup)
+	{
+		for (std::size_t i = 0; i < count; ++i)
 		{
-			UpdateWeight(ids[i], weights[i], lookup);
+			std::fill_n(lookup + changes[i].start, changes[i].count, changes[i].id);
+		}
+	}
+
+	/* @brief Opens a transaction: UpdateWeight, SetWeights and UpdateLookup
+	 * calls until Commit or Rollback log painted cells and previous head
+	 * states, so Rollback restores both exactly in time proportional to the
+	 * cells changed, with no copy of the lookup or of previous weights.
+	 * Begin within a transaction commits it first.
+	 */
+	void Begin()
+	{
+		Commit();
+		undo_active_ = active_;
+		transaction_ = true;
+	}
+
+	/* @brief Keeps changes of the transaction, log capacity is reused by
+	 * the next one.
+	 */
+	void Commit()
+	{
+		undo_cells_.clear();
+		undo_heads_.clear();
+		transaction_ = false;
+	}
+
+	/* @brief Undoes the transaction in \lookup, the one it has been
+	 * updating, no-op without one. The recorder sees previous weights of
+	 * the touched reals as an UpdateLookup call.
+	 */
+	void Rollback(RealId* lookup)
+	{
+		if (!transaction_)
+		{
+			return;
+		}
+		for (auto slice = undo_cells_.rbegin(); slice != undo_cells_.rend(); ++slice)
+		{
+			std::fill_n(lookup + slice->start, slice->count, slice->was);
+			balance_.Move(slice->id, slice->was, slice->count);
+		}
+		if (changes_ != nullptr)
+		{
+			for (auto slice = undo_cells_.rbegin(); slice != undo_cells_.rend(); ++slice)
+			{
+				changes_->push_back(Slice{slice->start, slice->count, slice->was, slice->id});
+			}
+		}
+		for (auto head = undo_heads_.rbegin(); head != undo_heads_.rend(); ++head)
+		{
+			auto& [id, enabled] = *head;
+			auto& info = heads_.at(id);
+			for (Index i = std::min(info.enabled, enabled); i < std::max(info.enabled, enabled); ++i)
+			{
+				enabled_[info.heads[i]] = i < enabled;
+			}
+			info.enabled = enabled;
+			balance_.Enabled(id, enabled);
+		}
+		active_ = undo_active_;
+		balance_.Settle();
+
+		if (recorder_ != nullptr && !undo_heads_.empty())
+		{
+			std::vector<RealId> ids;
+			std::vector<Weight> weights;
+			for (const auto& [id, enabled] : undo_heads_)
+			{
+				ids.push_back(id);
+				weights.push_back(heads_.at(id).enabled / segments_per_weight_);
+			}
+			recorder_->Record(service_, Operation::UPDATE_LOOKUP, ids.data(), weights.data(), ids.size());
 		}
+		Commit();
+	}
+
+	/* @brief Same as above and appends the restoring runs of cells to
+	 * \changes, for copies of the lookup kept by ApplyChanges.
+	 */
+	void Rollback(RealId* lookup, std::pmr::vector<Slice>& changes)
+	{
+		changes_ = &changes;
+		Rollback(lookup);
+		changes_ = nullptr;
+	}
+
+	bool InTransaction() const
+	{
+		return transaction_;
+	}
+
+	/* @brief Passes every following UpdateWeight, SetWeights and UpdateLookup
+	 * call to \recorder tagged with \service, nullptr detaches. The recorder
+	 * must outlive the updater or be detached first.
+	 */
+	void SetRecorder(Recorder* recorder, std::uint32_t service = 0)
+	{
+		recorder_ = recorder;
+		service_ = service;
+	}
+
+	/* @brief Counters and histograms of Config::Stats, empty NullStats by
+	 * default.
+	 */
+	const Stats& Statistics() const
+	{
+		return stats_;
+	}
+
+	void ResetStatistics()
+	{
+		stats_ = Stats{};
 	}
 
 	static bool Valid(RealId id)
@@ -360,12 +587,18 @@ public:
 		return std::numeric_limits<RealId>::max();
 	}
 
-	void InitLookup(RealId* lookup)
+	void InitLookup(RealId* lookup) const
 	{
+		ScopedLatency latency(stats_, Operation::INIT_LOOKUP);
 		std::fill(lookup, lookup + lookup_size_, Invalid());
+		if (balance_.Active())
+		{
+			balance_.Start(heads_, lookup_size_);
+		}
 
 		if (Disabled())
 		{
+			balance_.Settle();
 			return;
 		}
 
@@ -381,20 +614,177 @@ public:
 		RealId tint = *lookup;
 		if (!Valid(tint))
 		{
-			tint = *std::find_if(std::reverse_iterator(lookup + lookup_size_ - 1),
-			                     std::reverse_iterator(lookup - 1),
+			tint = *std::find_if(std::reverse_iterator(lookup + lookup_size_),
+			                     std::reverse_iterator(lookup),
 			                     [](const RealId& id) {
 				                     return Valid(id);
 			                     });
 		}
 
-		std::for_each(lookup, lookup + lookup_size_, [&](RealId& id) {
-			if (Valid(id))
+		std::size_t run{};
+		for (std::size_t i = 0; i < lookup_size_; ++i)
+		{
+			if (Valid(lookup[i]) && lookup[i] != tint)
 			{
-				tint = id;
+				balance_.Add(tint, i - run);
+				run = i;
+				tint = lookup[i];
 			}
-			id = tint;
+			lookup[i] = tint;
+		}
+		balance_.Add(tint, lookup_size_ - run);
+		balance_.Settle();
+	}
+
+	/* @brief Counts cells of every real in \lookup, which must be kept by
+	 * this updater, and keeps the counts up to date in InitLookup,
+	 * UpdateWeight and UpdateLookup from now on. Tracking makes updates
+	 * slower, mostly for reals with many slices.
+	 */
+	void TrackBalance(const RealId* lookup)
+	{
+		balance_.Start(heads_, lookup_size_);
+		for (std::size_t i = 0, run = 0; i < lookup_size_; i = run)
+		{
+			for (run = i; run < lookup_size_ && lookup[run] == lookup[i]; ++run)
+			{
+			}
+			balance_.Add(lookup[i], run - i);
+		}
+		balance_.Settle();
+	}
+
+	void StopBalance()
+	{
+		balance_.Stop();
+	}
+
+	/* @brief Share of lookup cells held by \id while TrackBalance is on, 0
+	 * otherwise. SetWeights is not reflected until the next InitLookup.
+	 */
+	double EffectiveShare(RealId id) const
+	{
+		return balance_.Share(id);
+	}
+
+	/* @brief Largest relative difference between the effective and the
+	 * requested share over enabled reals while TrackBalance is on, same as
+	 * counting cells of the whole lookup but O(1).
+	 */
+	double MaxWeightError() const
+	{
+		return balance_.MaxError();
+	}
+
+	/* @brief Cells UpdateLookup(\ids, \weights, \count) would move in
+	 * \lookup, which is read only and must be kept by this updater. Every
+	 * cell belongs to the real of the nearest enabled head at or before it,
+	 * so only runs starting at heads the change toggles are walked, each up
+	 * to the next head enabled both before and after the change.
+	 */
+	Disruption EstimateDisruption(const RealId* ids, const Weight* weights, Index count, const RealId* lookup) const
+	{
+		struct Toggle
+		{
+			Index pos;
+			RealId id;
+			bool enabled;
+		};
+
+		// later weights of the same real win, as in UpdateLookup
+		std::unordered_map<RealId, Index> targets;
+		for (Index i = 0; i < count; ++i)
+		{
+			if (auto h = heads_.find(ids[i]); h != heads_.end())
+			{
+				targets[ids[i]] = std::min<std::size_t>(weights[i] * segments_per_weight_, h->second.heads.size());
+			}
+		}
+		std::vector<Toggle> toggles;
+		for (const auto& [id, target] : targets)
+		{
+			const RealInfo& info = heads_.at(id);
+			for (Index i = std::min(info.enabled, target); i < std::max(info.enabled, target); ++i)
+			{
+				toggles.push_back(Toggle{info.heads[i], id, target > info.enabled});
+			}
+		}
+
+		Disruption result;
+		if (toggles.empty())
+		{
+			return result;
+		}
+		std::sort(toggles.begin(), toggles.end(), [](const Toggle& a, const Toggle& b) {
+			return a.pos < b.pos;
 		});
+
+		// run from a toggled head ends at the next toggled head or earlier at
+		// an untouched enabled one, past which nothing changes
+		std::size_t size = toggles.size();
+		auto gap = [&](std::size_t k) -> Index {
+			Index cells = (toggles[(k + 1) % size].pos + lookup_size_ - toggles[k].pos) % lookup_size_;
+			return cells == 0 ? lookup_size_ : cells;
+		};
+		std::vector<Index> ends(size);
+		std::optional<std::size_t> first;
+		for (std::size_t k = 0; k < size; ++k)
+		{
+			Index pos = toggles[k].pos;
+			Index cells = gap(k);
+			Index end = 1;
+			for (Index i = pos + 1; end < cells && !enabled_[i < lookup_size_ ? i : i - lookup_size_]; ++end, ++i)
+			{
+			}
+			ends[k] = end;
+			if (end != cells && !first)
+			{
+				first = (k + 1) % size;
+			}
+		}
+
+		// owner after the change of the cell before the first run
+		RealId owner = Invalid();
+		if (first)
+		{
+			owner = lookup[(toggles[*first].pos + lookup_size_ - 1) % lookup_size_];
+		}
+		else
+		{
+			first = 0;
+			for (const Toggle& toggle : toggles)
+			{
+				owner = toggle.enabled ? toggle.id : owner;
+			}
+		}
+
+		std::unordered_map<RealId, std::size_t> donors;
+		std::unordered_map<RealId, std::size_t> receivers;
+		for (std::size_t n = 0, k = *first; n < size; ++n, k = (k + 1) % size)
+		{
+			const Toggle& toggle = toggles[k];
+			if (toggle.enabled)
+			{
+				owner = toggle.id;
+			}
+			RealId was = lookup[toggle.pos];
+			if (owner != was)
+			{
+				result.moved += ends[k];
+				donors[was] += ends[k];
+				receivers[owner] += ends[k];
+			}
+			if (ends[k] != gap(k))
+			{
+				owner = lookup[(toggles[(k + 1) % size].pos + lookup_size_ - 1) % lookup_size_];
+			}
+		}
+
+		result.donors.assign(donors.begin(), donors.end());
+		result.receivers.assign(receivers.begin(), receivers.end());
+		std::sort(result.donors.begin(), result.donors.end());
+		std::sort(result.receivers.begin(), result.receivers.end());
+		return result;
 	}
 
 	bool Disabled() const
@@ -407,6 +797,545 @@ public:
 	}
 };
 
+/* @brief Temporary buffers of BasicUpdaterMaker. Buffers keep their capacity
+ * between constructions, so a scratch reused for many services stops
+ * allocating once it has seen the largest of them, see BasicUpdaterBuilder.
+ */
+template<typename Config>
+struct BasicMakerScratch
+{
+	using Index = typename Config::Index;
+	using RealInfo = BasicRealInfo<Config>;
+
+	// reals in order of the first appearance in input, rings match to
+	// positions in this order instead of ids to avoid hash lookups per head
+	std::pmr::vector<RealInfo*> infos;
+	std::pmr::vector<Index> dense;
+	std::pmr::vector<RealInfo*> donors;
+	std::pmr::vector<RealInfo*> receivers;
+	// positions and owners of a parallel batch, parts[p] heads of part p
+	// are at p * chunk, parts holds prefix sums of their counts
+	std::pmr::vector<std::uint32_t> batch;
+	std::pmr::vector<Index> owners;
+	std::pmr::vector<std::size_t> parts;
+	// rings are rebuilt in place, only the first built_rings are valid
+	std::pmr::vector<Unweighted<Index>> rings;
+	Index built_rings{};
+	typename Unweighted<Index>::Candidates candidates;
+	// per dense real, whether some ring contains it
+	std::pmr::vector<bool> covered;
+	std::pmr::vector<std::uint32_t> pending;
+
+	explicit BasicMakerScratch(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+	        infos(resource),
+	        dense(resource),
+	        donors(resource),
+	        receivers(resource),
+	        batch(resource),
+	        owners(resource),
+	        parts(resource),
+	        rings(resource),
+	        candidates(resource),
+	        covered(resource),
+	        pending(resource)
+	{
+	}
+
+	std::pmr::memory_resource* Resource() const
+	{
+		return infos.get_allocator().resource();
+	}
+
+	// drops contents but keeps capacity, rings are kept for reuse
+	void Clear()
+	{
+		infos.clear();
+		dense.clear();
+		donors.clear();
+		receivers.clear();
+		batch.clear();
+		owners.clear();
+		parts.clear();
+		built_rings = 0;
+		candidates.clear();
+		covered.clear();
+		pending.clear();
+	}
+};
+
+/* @brief Builds BasicWeightUpdater in bounded steps so that construction of a
+ * big service can be interleaved with other work of a single-threaded caller.
+ * Construction goes through phases: side rings are built one per step, then
+ * heads are distributed one per step and finally excessive heads of every
+ * real are disabled one real per step. MakeWeightUpdater is this maker run to
+ * completion, so the result does not depend on how the work was split.
+ * With Config::Rng drawing heads independently heads can be matched to reals
+ * by several threads, see SetThreads. The updater and all temporaries are
+ * allocated from \resource unless temporaries are borrowed from a scratch.
+ * \reals must outlive the maker.
+ */
+template<typename Config, typename Real>
+class BasicUpdaterMaker
+{
+public:
+	using Updater = BasicWeightUpdater<Config>;
+	using Index = typename Config::Index;
+	using RealId = typename Config::RealId;
+	using Weight = typename Config::Weight;
+	using Scratch = BasicMakerScratch<Config>;
+	using RingCache = BasicRingCache<Real, Config>;
+
+	enum class Phase
+	{
+		RINGS,
+		HEADS,
+		TRIM,
+		DONE,
+		FAILED
+	};
+
+private:
+	const Real* reals_;
+	Index cnt_;
+	Index side_rings_count_;
+	Index segments_per_weight_;
+	Index lookup_size_;
+	Phase phase_ = Phase::FAILED;
+	std::optional<Updater> updater_;
+
+	// either own scratch or the one borrowed from the caller
+	std::optional<Scratch> own_;
+	Scratch* borrowed_{};
+	Index uncovered_{};
+
+	// rings heads are matched with, built in scratch or taken from cache
+	RingCache* cache_{};
+	std::shared_ptr<const typename RingCache::RingSet> cached_;
+	const Unweighted<Index>* rings_{};
+	Index ring_count_{};
+
+	typename Config::Rng rng_{Config::RNG_SEED};
+	std::size_t threads_ = 1;
+	// started on the first parallel batch and kept until the maker is gone
+	std::unique_ptr<WorkerPool> pool_;
+
+	static constexpr std::size_t PENDING_POSITIONS = 4 * BitReversedPositions::BLOCK;
+	std::optional<BitReversedPositions> positions_;
+	// MAKE latency is wall time from creation of the maker to DONE
+	std::chrono::steady_clock::time_point started_;
+	std::size_t next_{};
+	std::size_t u_{};
+	Index distributed_{};
+	Index need_heads_{};
+
+	typename std::pmr::unordered_map<RealId, typename Updater::RealInfo>::iterator trim_;
+
+public:
+	BasicUpdaterMaker(const Real* reals,
+	                  const RealId* ids,
+	                  const Weight* weights,
+	                  Index cnt,
+	                  Index side_rings_count,
+	                  Index segments_per_weight,
+	                  Index lookup_size,
+	                  std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+	        BasicUpdaterMaker(reals, ids, weights, cnt, side_rings_count, segments_per_weight, lookup_size, nullptr, resource)
+	{
+	}
+
+	/* @brief Same as above, but temporaries are taken from \scratch, which
+	 * must outlive the maker and must not be shared by two makers at once.
+	 * Only the updater is allocated from \resource.
+	 */
+	BasicUpdaterMaker(const Real* reals,
+	                  const RealId* ids,
+	                  const Weight* weights,
+	                  Index cnt,
+	                  Index side_rings_count,
+	                  Index segments_per_weight,
+	                  Index lookup_size,
+	                  Scratch& scratch,
+	                  std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+	        BasicUpdaterMaker(reals, ids, weights, cnt, side_rings_count, segments_per_weight, lookup_size, &scratch, resource)
+	{
+	}
+
+private:
+	BasicUpdaterMaker(const Real* reals,
+	                  const RealId* ids,
+	                  const Weight* weights,
+	                  Index cnt,
+	                  Index side_rings_count,
+	                  Index segments_per_weight,
+	                  Index lookup_size,
+	                  Scratch* scratch,
+	                  std::pmr::memory_resource* resource) :
+	        reals_{reals},
+	        cnt_{cnt},
+	        side_rings_count_{side_rings_count},
+	        segments_per_weight_{segments_per_weight},
+	        lookup_size_{lookup_size},
+	        borrowed_{scratch}
+	{
+		if (borrowed_ == nullptr)
+		{
+			own_.emplace(resource);
+		}
+		if constexpr (Config::Stats::ENABLED)
+		{
+			started_ = std::chrono::steady_clock::now();
+		}
+		auto& s = Temp();
+		s.Clear();
+
+		if (cnt == 0 ||
+		    side_rings_count + segments_per_weight * Config::MaxWeight == 0 ||
+		    side_rings_count < 1 ||
+		    lookup_size < segments_per_weight * Config::MaxWeight)
+		{
+			return;
+		}
+		updater_.emplace(Updater(segments_per_weight, lookup_size, resource));
+		for (Index i = 0; i < cnt; ++i)
+		{
+			auto [it, inserted] = updater_->heads_.try_emplace(ids[i]);
+			auto& info = it->second;
+			if (inserted)
+			{
+				s.dense.push_back(s.infos.size());
+				s.infos.push_back(&info);
+			}
+			else
+			{
+				// repeated id shares the info of its first appearance
+				s.dense.push_back(std::find(s.infos.begin(), s.infos.end(), &info) - s.infos.begin());
+			}
+			info.enabled = weights[i] * segments_per_weight;
+			if (info.enabled != 0)
+			{
+				++updater_->active_;
+			}
+		}
+		s.covered.assign(s.infos.size(), false);
+		uncovered_ = s.infos.size();
+		positions_.emplace(lookup_size);
+		need_heads_ = Updater::LookupRequiredSize(cnt, segments_per_weight);
+		for (auto* info : s.infos)
+		{
+			info->heads.reserve(need_heads_ / s.infos.size());
+		}
+		phase_ = Phase::RINGS;
+	}
+
+public:
+	Phase Current() const
+	{
+		return phase_;
+	}
+
+	bool Finished() const
+	{
+		return phase_ == Phase::DONE || phase_ == Phase::FAILED;
+	}
+
+	/* @brief Sets number of threads used to match heads to reals. Takes
+	 * effect only with Config::Rng drawing heads independently, the result
+	 * is the same for any number of threads.
+	 */
+	void SetThreads(std::size_t threads)
+	{
+		threads_ = std::max<std::size_t>(threads, 1);
+	}
+
+	/* @brief Takes side rings from \cache if it has them for the same reals
+	 * and puts rings built otherwise there. Must be set before the first
+	 * step, \cache must outlive the maker.
+	 */
+	void SetRingCache(RingCache* cache)
+	{
+		cache_ = cache;
+	}
+
+	/* @brief Performs at most \budget steps of construction and returns the
+	 * phase reached. A step is building one side ring, placing one head or
+	 * disabling excessive heads of one real.
+	 */
+	Phase Step(std::size_t budget)
+	{
+		while (budget != 0 && !Finished())
+		{
+			switch (phase_)
+			{
+				case Phase::RINGS:
+					budget = BuildRings(budget);
+					break;
+				case Phase::HEADS:
+					budget = DistributeHeads(budget);
+					break;
+				case Phase::TRIM:
+					budget = Trim(budget);
+					break;
+				default:
+					break;
+			}
+		}
+		return phase_;
+	}
+
+	/* @brief Returns constructed updater once the maker is DONE, std::nullopt
+	 * otherwise.
+	 */
+	std::optional<Updater> Result()
+	{
+		if (phase_ != Phase::DONE)
+		{
+			return std::nullopt;
+		}
+		return std::move(updater_);
+	}
+
+private:
+	Scratch& Temp()
+	{
+		return borrowed_ != nullptr ? *borrowed_ : *own_;
+	}
+
+	std::size_t BuildRings(std::size_t budget)
+	{
+		auto& s = Temp();
+		if (cache_ != nullptr && s.built_rings == 0)
+		{
+			cached_ = cache_->Find(reals_, s.dense.data(), cnt_, side_rings_count_, Config::DEFAULT_UNWEIGHTED_SIZE);
+			if (cached_)
+			{
+				// heads are drawn after salts from the same generator
+				for (Index i = 0; i < side_rings_count_; ++i)
+				{
+					rng_.NextSalt();
+				}
+				rings_ = cached_->rings.data();
+				ring_count_ = cached_->rings.size();
+				phase_ = cached_->covered ? Phase::HEADS : Phase::FAILED;
+				return budget - 1;
+			}
+		}
+
+		for (; budget != 0 && s.built_rings < side_rings_count_; --budget)
+		{
+			if (s.rings.size() == s.built_rings)
+			{
+				s.rings.emplace_back(s.Resource());
+			}
+			auto salt = rng_.NextSalt();
+			auto& ring = s.rings[s.built_rings++];
+			std::size_t contain = ring.Assign(reals_, s.dense.data(), cnt_, salt, Config::DEFAULT_UNWEIGHTED_SIZE, s.candidates);
+			for (std::size_t k = 0; k < contain; ++k)
+			{
+				Index id = s.dense[s.candidates[k].second];
+				if (!s.covered[id])
+				{
+					s.covered[id] = true;
+					--uncovered_;
+				}
+			}
+		}
+
+		if (s.built_rings == side_rings_count_)
+		{
+			rings_ = s.rings.data();
+			ring_count_ = s.built_rings;
+			if (cache_ != nullptr)
+			{
+				cached_ = cache_->Insert(typename RingCache::RingSet{
+				        RingCache::Fingerprint(reals_, s.dense.data(), cnt_, side_rings_count_, Config::DEFAULT_UNWEIGHTED_SIZE),
+				        std::vector<Real>(reals_, reals_ + cnt_),
+				        std::vector<Index>(s.dense.begin(), s.dense.end()),
+				        Config::DEFAULT_UNWEIGHTED_SIZE,
+				        std::vector<Unweighted<Index>>(s.rings.begin(), s.rings.begin() + s.built_rings),
+				        uncovered_ == 0});
+			}
+			// unweighted rings don't contain some reals due to collisions
+			phase_ = uncovered_ == 0 ? Phase::HEADS : Phase::FAILED;
+		}
+		return budget;
+	}
+
+	std::size_t DistributeHeads(std::size_t budget)
+	{
+		while (budget != 0 && distributed_ < need_heads_)
+		{
+			if constexpr (Config::Rng::INDEPENDENT)
+			{
+				// positions drawn ahead for single-threaded steps go first
+				if (threads_ > 1 && next_ == Temp().pending.size())
+				{
+					budget = DistributeBatch(budget);
+					continue;
+				}
+			}
+
+			--budget;
+			Place(NextPosition(), rings_[u_].Match(rng_.Head(distributed_)));
+		}
+
+		if (distributed_ == need_heads_)
+		{
+			trim_ = updater_->heads_.begin();
+			phase_ = Phase::TRIM;
+		}
+		return budget;
+	}
+
+	/* @brief Splits indices of positions up to the next Rebalance into
+	 * consecutive ranges, one per worker. Each worker enumerates positions of
+	 * its range, then matches them to reals by head number, and heads are
+	 * placed in order. Possible only if hash of a head depends on nothing but
+	 * its index.
+	 */
+	std::size_t DistributeBatch(std::size_t budget)
+	{
+		if (!pool_ || pool_->Threads() != threads_)
+		{
+			pool_ = std::make_unique<WorkerPool>(threads_);
+		}
+		// an index yields at most one head, so the batch never passes Rebalance
+		Index round = segments_per_weight_ * cnt_;
+		std::size_t span = std::min<std::size_t>({budget, need_heads_ - distributed_, round - distributed_ % round});
+		std::size_t parts = std::clamp<std::size_t>(span / BitReversedPositions::BLOCK, 1, threads_);
+		std::size_t chunk = (span + parts - 1) / parts;
+		std::uint64_t first = positions_->Index();
+		auto& s = Temp();
+		s.batch.resize(span);
+		s.owners.resize(span);
+		s.parts.assign(parts + 1, 0);
+
+		pool_->Run(parts, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t p = begin; p < end; ++p)
+			{
+				BitReversedPositions positions = *positions_;
+				positions.Seek(first + p * chunk);
+				s.parts[p + 1] = positions.Take(s.batch.data() + p * chunk, std::min(chunk, span - p * chunk));
+			}
+		});
+		positions_->Seek(first + span);
+		std::partial_sum(s.parts.begin(), s.parts.end(), s.parts.begin());
+
+		pool_->Run(parts, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t p = begin; p < end; ++p)
+			{
+				for (std::size_t k = 0; k < s.parts[p + 1] - s.parts[p]; ++k)
+				{
+					std::size_t head = distributed_ + s.parts[p] + k;
+					s.owners[p * chunk + k] = rings_[head % ring_count_].Match(rng_.Head(head));
+				}
+			}
+		});
+
+		for (std::size_t p = 0; p < parts; ++p)
+		{
+			for (std::size_t k = 0; k < s.parts[p + 1] - s.parts[p]; ++k)
+			{
+				Place(s.batch[p * chunk + k], s.owners[p * chunk + k]);
+			}
+		}
+		return budget - s.parts[parts];
+	}
+
+	Index NextPosition()
+	{
+		auto& pending = Temp().pending;
+		if (next_ == pending.size())
+		{
+			pending.resize(PENDING_POSITIONS);
+			positions_->Next(pending.data(), pending.size());
+			next_ = 0;
+		}
+		return pending[next_++];
+	}
+
+	void Place(Index pos, Index owner)
+	{
+		auto& s = Temp();
+		s.infos[owner]->heads.push_back(pos);
+		u_ = NextRingPosition(ring_count_, u_);
+		updater_->enabled_[pos] = true;
+		++distributed_;
+
+		if (distributed_ % (segments_per_weight_ * cnt_) == 0)
+		{
+			Rebalance(distributed_ / s.infos.size());
+		}
+	}
+
+	/* @brief Moves heads from reals holding more than \target heads to reals
+	 * holding less. Heads are taken from the back of donor chain and moved in
+	 * bulk, as many as both donor and receiver can afford at once. Reals are
+	 * paired in the order of heads_, which lookups built by earlier versions
+	 * depend on.
+	 */
+	void Rebalance(Index target)
+	{
+		auto& s = Temp();
+		s.donors.clear();
+		s.receivers.clear();
+		for (auto& [id, info] : updater_->heads_)
+		{
+			if (info.heads.size() > target)
+			{
+				s.donors.push_back(&info);
+			}
+			else if (info.heads.size() < target)
+			{
+				s.receivers.push_back(&info);
+			}
+		}
+
+		auto d = s.donors.begin();
+		for (auto r = s.receivers.begin(); r != s.receivers.end() && d != s.donors.end();)
+		{
+			auto& to = (*r)->heads;
+			auto& from = (*d)->heads;
+			std::size_t move = std::min(target - to.size(), from.size() - target);
+			to.insert(to.end(), from.rbegin(), from.rbegin() + move);
+			from.resize(from.size() - move);
+			updater_->stats_.RebalanceMoved(move);
+
+			if (to.size() == target)
+			{
+				++r;
+			}
+			if (from.size() == target)
+			{
+				++d;
+			}
+		}
+	}
+
+	std::size_t Trim(std::size_t budget)
+	{
+		for (; budget != 0 && trim_ != updater_->heads_.end(); --budget, ++trim_)
+		{
+			auto& info = trim_->second;
+			std::for_each(info.heads.begin() + info.enabled,
+			              info.heads.end(),
+			              [&](const Index pos) {
+				              updater_->enabled_[pos] = false;
+			              });
+		}
+
+		if (trim_ == updater_->heads_.end())
+		{
+			phase_ = Phase::DONE;
+			if constexpr (Config::Stats::ENABLED)
+			{
+				auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started_);
+				updater_->stats_.Latency(Operation::MAKE, ns.count());
+			}
+		}
+		return budget;
+	}
+};
+
 using WeightUpdater = BasicWeightUpdater<DefaultConfig>;
 
 template<typename Real>
@@ -436,7 +1365,8 @@ std::optional<WeightUpdater> MakeWeightUpdater(
         WeightUpdater::Index cnt,
         WeightUpdater::Index side_rings_count,
         WeightUpdater::Index segments_per_weight,
-        WeightUpdater::Index lookup_size)
+        WeightUpdater::Index lookup_size,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource())
 {
 	return WeightUpdater::MakeWeightUpdater(
 	        reals,
@@ -445,7 +1375,8 @@ std::optional<WeightUpdater> MakeWeightUpdater(
 	        cnt,
 	        side_rings_count,
 	        segments_per_weight,
-	        lookup_size);
+	        lookup_size,
+	        resource);
 }
 
 } // namespace chash
\ No newline at end of file
@@ -5,6 +5,9 @@
 #define GCC_BUG_UNUSED(arg) (void)(arg);
 #endif
 
+#include "rng.hpp"
+#include "stats.hpp"
+
 namespace chash
 {
 
@@ -17,6 +20,10 @@ struct DefaultConfig
 	static const Weight MaxWeight = 100;
 	static constexpr std::mt19937::result_type RNG_SEED = 42;
 	static constexpr std::size_t DEFAULT_UNWEIGHTED_SIZE = 65553;
+	// SequentialRng or CounterRng, the latter allows parallel construction
+	using Rng = SequentialRng;
+	// NullStats or UpdaterStats, the latter counts work and latencies
+	using Stats = NullStats;
 };
 
 } // namespace chash
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <optional>
+
+#include "chash.hpp"
+
+namespace chash
+{
+
+/* @brief Updater with lookup size fixed at compile time. Owns its lookup in
+ * cache line aligned storage, wraps ring walks with constant (mask for
+ * powers of two) arithmetic and lets compiler specialize slice walks for the
+ * size. Intended for a few standard table sizes shared by many services.
+ */
+template<std::size_t Size, typename Config = DefaultConfig>
+class BasicFixedWeightUpdater : private BasicWeightUpdater<Config>
+{
+	using Base = BasicWeightUpdater<Config>;
+	using Ring = StaticRing<Size>;
+
+public:
+	using Index = typename Config::Index;
+	using RealId = typename Config::RealId;
+	using Weight = typename Config::Weight;
+
+	static constexpr std::size_t ALIGNMENT = 64;
+
+	struct alignas(ALIGNMENT) Storage
+	{
+		std::array<RealId, Size> cells;
+	};
+
+private:
+	std::unique_ptr<Storage> lookup_;
+
+	explicit BasicFixedWeightUpdater(Base&& base) :
+	        Base(std::move(base)),
+	        lookup_{new Storage}
+	{
+		Base::InitLookup(lookup_->cells.data());
+	}
+
+public:
+	using Base::Disabled;
+	using Base::EffectiveShare;
+	using Base::Invalid;
+	using Base::LookupRequiredSize;
+	using Base::MaxWeightError;
+	using Base::SetRecorder;
+	using Base::Statistics;
+	using Base::StopBalance;
+	using Base::Valid;
+
+	static constexpr Index LookupSize()
+	{
+		return Size;
+	}
+
+	/* @brief Takes over \base built for lookup of \Size cells and
+	 * initializes own lookup from it.
+	 */
+	static std::optional<BasicFixedWeightUpdater> From(Base&& base)
+	{
+		if (base.LookupSize() != Size)
+		{
+			return std::nullopt;
+		}
+		return BasicFixedWeightUpdater(std::move(base));
+	}
+
+	template<typename Real>
+	static std::optional<BasicFixedWeightUpdater> MakeWeightUpdater(
+	        const Real* reals,
+	        const RealId* ids,
+	        const Weight* weights,
+	        Index cnt,
+	        Index side_rings_count,
+	        Index segments_per_weight)
+	{
+		auto base = Base::MakeWeightUpdater(reals,
+		                                    ids,
+		                                    weights,
+		                                    cnt,
+		                                    side_rings_count,
+		                                    segments_per_weight,
+		                                    Size);
+		if (!base)
+		{
+			return std::nullopt;
+		}
+		return From(std::move(base.value()));
+	}
+
+	const RealId* Lookup() const
+	{
+		return lookup_->cells.data();
+	}
+
+	RealId Select(std::uint32_t hash) const
+	{
+		return lookup_->cells[hash % Size];
+	}
+
+	void InitLookup()
+	{
+		Base::InitLookup(lookup_->cells.data());
+	}
+
+	void TrackBalance()
+	{
+		Base::TrackBalance(lookup_->cells.data());
+	}
+
+	void UpdateWeight(RealId id, Weight weight)
+	{
+		Base::Update(Operation::UPDATE_WEIGHT, &id, &weight, 1, lookup_->cells.data(), Ring{});
+	}
+
+	void UpdateLookup(const RealId* ids, const Weight* weights, Index count)
+	{
+		Base::Update(Operation::UPDATE_LOOKUP, ids, weights, count, lookup_->cells.data(), Ring{});
+	}
+};
+
+} // namespace chash
@@ -0,0 +1,252 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "chash.hpp"
+
+namespace chash
+{
+
+/* @brief Binary journal of control plane weight events, used to replay
+ * production sequences of weight changes against the library.
+ *
+ * Layout is a JournalHeader followed by records, each one call of an
+ * updater: varint nanoseconds since the previous record, one byte of
+ * Operation, varint service, varint count and count pairs of varint id and
+ * varint weight. Operation::MAKE records hold initial weights of a service,
+ * reals are not recorded, so journals carry no addresses.
+ */
+struct JournalHeader
+{
+	static constexpr char MAGIC[8] = {'C', 'H', 'A', 'S', 'H', 'J', 'R', 'N'};
+	static constexpr std::uint32_t VERSION = 1;
+
+	char magic[8];
+	std::uint32_t version;
+	std::uint8_t real_id_size;
+	std::uint8_t weight_size;
+	std::uint8_t reserved[2];
+};
+
+template<typename Config = DefaultConfig>
+struct BasicJournalRecord
+{
+	std::uint64_t timestamp;
+	std::uint32_t service;
+	Operation op;
+	std::vector<typename Config::RealId> ids;
+	std::vector<typename Config::Weight> weights;
+};
+
+/* @brief Recorder appending calls of updaters to an in-memory journal.
+ * Timestamps are nanoseconds since construction of the writer.
+ */
+template<typename Config = DefaultConfig>
+class BasicJournalWriter : public BasicRecorder<Config>
+{
+public:
+	using Index = typename Config::Index;
+	using RealId = typename Config::RealId;
+	using Weight = typename Config::Weight;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	mutable std::mutex mutex_;
+	std::vector<std::uint8_t> data_;
+	Clock::time_point start_{Clock::now()};
+	std::uint64_t last_{};
+	std::size_t events_{};
+
+	void Put(std::uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			data_.push_back(static_cast<std::uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		data_.push_back(static_cast<std::uint8_t>(value));
+	}
+
+	void Append(std::uint32_t service, Operation op, const RealId* ids, const Weight* weights, Index count)
+	{
+		auto now = static_cast<std::uint64_t>(
+		        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count());
+		std::lock_guard lock(mutex_);
+		// records from concurrent updaters may race for the lock
+		now = std::max(now, last_);
+		Put(now - last_);
+		last_ = now;
+		data_.push_back(static_cast<std::uint8_t>(op));
+		Put(service);
+		Put(count);
+		for (Index i = 0; i < count; ++i)
+		{
+			Put(ids[i]);
+			Put(weights[i]);
+		}
+		events_ += count;
+	}
+
+public:
+	BasicJournalWriter()
+	{
+		JournalHeader header{};
+		std::memcpy(header.magic, JournalHeader::MAGIC, sizeof(header.magic));
+		header.version = JournalHeader::VERSION;
+		header.real_id_size = sizeof(RealId);
+		header.weight_size = sizeof(Weight);
+		data_.resize(sizeof(header));
+		std::memcpy(data_.data(), &header, sizeof(header));
+	}
+
+	/* @brief Records initial weights of \service, replay builds the service
+	 * from them.
+	 */
+	void Declare(std::uint32_t service, const RealId* ids, const Weight* weights, Index count)
+	{
+		Append(service, Operation::MAKE, ids, weights, count);
+	}
+
+	void Record(std::uint32_t service, Operation op, const RealId* ids, const Weight* weights, Index count) override
+	{
+		Append(service, op, ids, weights, count);
+	}
+
+	/* @brief Number of (id, weight) pairs recorded so far.
+	 */
+	std::size_t Events() const
+	{
+		std::lock_guard lock(mutex_);
+		return events_;
+	}
+
+	std::vector<std::uint8_t> Data() const
+	{
+		std::lock_guard lock(mutex_);
+		return data_;
+	}
+};
+
+/* @brief Sequential decoder of a journal in \data of \size bytes, which
+ * must outlive the reader.
+ */
+template<typename Config = DefaultConfig>
+class BasicJournalReader
+{
+public:
+	using Record = BasicJournalRecord<Config>;
+	using RealId = typename Config::RealId;
+	using Weight = typename Config::Weight;
+
+private:
+	const std::uint8_t* data_;
+	std::size_t size_;
+	std::size_t offset_{sizeof(JournalHeader)};
+	std::uint64_t timestamp_{};
+
+	BasicJournalReader(const std::uint8_t* data, std::size_t size) :
+	        data_{data},
+	        size_{size}
+	{
+	}
+
+	std::optional<std::uint64_t> Get()
+	{
+		std::uint64_t value{};
+		for (unsigned shift = 0; shift < 64 && offset_ < size_; shift += 7)
+		{
+			std::uint8_t byte = data_[offset_++];
+			value |= std::uint64_t{byte & 0x7fu} << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return value;
+			}
+		}
+		return std::nullopt;
+	}
+
+public:
+	/* @brief Returns std::nullopt if \data is not a journal made for Config.
+	 */
+	static std::optional<BasicJournalReader> Open(const void* data, std::size_t size)
+	{
+		JournalHeader header;
+		if (size < sizeof(header))
+		{
+			return std::nullopt;
+		}
+		std::memcpy(&header, data, sizeof(header));
+		if (std::memcmp(header.magic, JournalHeader::MAGIC, sizeof(header.magic)) != 0 ||
+		    header.version != JournalHeader::VERSION ||
+		    header.real_id_size != sizeof(RealId) ||
+		    header.weight_size != sizeof(Weight))
+		{
+			return std::nullopt;
+		}
+		return BasicJournalReader(static_cast<const std::uint8_t*>(data), size);
+	}
+
+	/* @brief Decodes the next record, std::nullopt at the end of journal or
+	 * on a malformed record, see Complete.
+	 */
+	std::optional<Record> Next()
+	{
+		std::size_t begin = offset_;
+		auto fail = [&]() -> std::optional<Record> {
+			offset_ = begin;
+			return std::nullopt;
+		};
+
+		auto delta = Get();
+		if (!delta || offset_ >= size_ || data_[offset_] >= static_cast<std::uint8_t>(Operation::COUNT))
+		{
+			return fail();
+		}
+		Record record{timestamp_ + *delta, 0, static_cast<Operation>(data_[offset_++]), {}, {}};
+		auto service = Get();
+		auto count = Get();
+		// every event takes at least two bytes
+		if (!service || !count || *service > std::numeric_limits<std::uint32_t>::max() ||
+		    *count > (size_ - offset_) / 2)
+		{
+			return fail();
+		}
+		record.service = *service;
+		record.ids.reserve(*count);
+		record.weights.reserve(*count);
+		for (std::uint64_t i = 0; i < *count; ++i)
+		{
+			auto id = Get();
+			auto weight = Get();
+			if (!id || !weight || *id > std::numeric_limits<RealId>::max() ||
+			    *weight > std::numeric_limits<Weight>::max())
+			{
+				return fail();
+			}
+			record.ids.push_back(*id);
+			record.weights.push_back(*weight);
+		}
+		timestamp_ = record.timestamp;
+		return record;
+	}
+
+	/* @brief Whether every record has been decoded, false after Next stopped
+	 * at a truncated or corrupted one.
+	 */
+	bool Complete() const
+	{
+		return offset_ == size_;
+	}
+};
+
+using JournalWriter = BasicJournalWriter<DefaultConfig>;
+using JournalReader = BasicJournalReader<DefaultConfig>;
+
+} // namespace chash
@@ -0,0 +1,133 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+#include "bit-reverse.hpp"
+#include "utils.hpp"
+
+namespace chash
+{
+
+/* @brief Enumerates head positions ReverseBits(bits, i) for i = 0, 1, ... with
+ * bits = PowerOfTwoLowerBound(size), skipping positions not less than \size.
+ * Sequence is periodic with period of 2^bits indices.
+ *
+ * Indices are processed in aligned blocks of BLOCK: position of base + k is
+ * ReverseBits(bits, base) | ReverseBits(bits, k), so a block costs one bit
+ * reversal and the rest is branchless or-and-compact over a precomputed
+ * table. Generator may start at any index, so disjoint index ranges can be
+ * enumerated independently.
+ */
+class BitReversedPositions
+{
+public:
+	static constexpr std::uint8_t BLOCK_BITS = 8;
+	static constexpr std::uint32_t BLOCK = 1u << BLOCK_BITS;
+
+private:
+	std::uint32_t size_;
+	std::uint8_t bits_;
+	std::uint64_t period_;
+	std::uint64_t index_;
+	std::array<std::uint32_t, BLOCK> low_{};
+
+public:
+	explicit BitReversedPositions(std::uint32_t size, std::uint64_t index = 0) :
+	        size_{size},
+	        bits_{PowerOfTwoLowerBound(size)},
+	        period_{std::uint64_t{1} << bits_},
+	        index_{index % period_}
+	{
+		if (bits_ >= BLOCK_BITS)
+		{
+			for (std::uint32_t k = 0; k < BLOCK; ++k)
+			{
+				low_[k] = ReverseBits(bits_, k);
+			}
+		}
+	}
+
+	/* @brief Index the next position will be produced from.
+	 */
+	std::uint64_t Index() const
+	{
+		return index_;
+	}
+
+	void Seek(std::uint64_t index)
+	{
+		index_ = index % period_;
+	}
+
+	/* @brief Writes next \max valid positions to \out.
+	 */
+	void Next(std::uint32_t* out, std::size_t max)
+	{
+		std::size_t n{};
+		while (n < max)
+		{
+			if (bits_ >= BLOCK_BITS && index_ % BLOCK == 0 && max - n >= BLOCK)
+			{
+				n += Block(out + n);
+				continue;
+			}
+
+			std::uint32_t pos = At(index_);
+			index_ = (index_ + 1) % period_;
+			if (pos < size_)
+			{
+				out[n++] = pos;
+			}
+		}
+	}
+
+	/* @brief Writes valid positions of next \count indices to \out, which
+	 * must have room for \count, and returns how many were written.
+	 */
+	std::size_t Take(std::uint32_t* out, std::uint64_t count)
+	{
+		std::size_t n{};
+		while (count != 0)
+		{
+			if (bits_ >= BLOCK_BITS && index_ % BLOCK == 0 && count >= BLOCK)
+			{
+				n += Block(out + n);
+				count -= BLOCK;
+				continue;
+			}
+
+			std::uint32_t pos = At(index_);
+			index_ = (index_ + 1) % period_;
+			--count;
+			if (pos < size_)
+			{
+				out[n++] = pos;
+			}
+		}
+		return n;
+	}
+
+private:
+	// writes valid positions of the aligned block at index_, out must have
+	// room for BLOCK of them
+	std::size_t Block(std::uint32_t* out)
+	{
+		std::size_t n{};
+		std::uint32_t high = ReverseBits(bits_, index_);
+		for (std::uint32_t k = 0; k < BLOCK; ++k)
+		{
+			std::uint32_t pos = high | low_[k];
+			out[n] = pos;
+			n += pos < size_;
+		}
+		index_ = (index_ + BLOCK) % period_;
+		return n;
+	}
+
+	std::uint32_t At(std::uint64_t index) const
+	{
+		return bits_ == 0 ? 0 : ReverseBits(bits_, index);
+	}
+};
+
+} // namespace chash
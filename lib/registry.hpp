@@ -0,0 +1,442 @@
+#pragma once
+#include <algorithm>
+#include <map>
+#include <memory_resource>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#include "builder.hpp"
+#include "chash.hpp"
+#include "storage.hpp"
+#include "utils.hpp"
+
+namespace chash
+{
+
+/* @brief Owns many services, each an updater with its lookup. Lookups are
+ * packed into big slabs of LookupStorage and updaters share one pool, so a
+ * service costs little beyond its cells. Services are created with one
+ * UpdaterBuilder and can be updated in parallel, each by one thread, the
+ * pool is synchronized for updaters allocating while they are updated.
+ */
+template<typename Real, typename Config = DefaultConfig>
+class BasicServiceRegistry
+{
+public:
+	using Updater = BasicWeightUpdater<Config>;
+	using Index = typename Config::Index;
+	using RealId = typename Config::RealId;
+	using Weight = typename Config::Weight;
+	using ServiceId = std::uint32_t;
+	using Slice = typename Updater::Slice;
+
+	static constexpr std::size_t DEFAULT_SLAB_CELLS = 1u << 22;
+
+	struct ServiceSpec
+	{
+		const Real* reals;
+		const RealId* ids;
+		const Weight* weights;
+		Index count;
+		Index side_rings_count;
+		Index segments_per_weight;
+	};
+
+	struct ServiceUpdate
+	{
+		ServiceId service;
+		const RealId* ids;
+		const Weight* weights;
+		Index count;
+	};
+
+	// service and id a real has in it
+	struct Member
+	{
+		ServiceId service;
+		RealId id;
+	};
+
+	// cells of a service lookup repainted by SetRealWeight
+	struct DirtyRange
+	{
+		ServiceId service;
+		Index start;
+		Index count;
+	};
+
+	struct MemoryUsage
+	{
+		std::size_t services;
+		// bytes mapped for slabs and taken by lookups in them
+		std::size_t slabs;
+		std::size_t lookups;
+		// bytes taken by updaters from the shared pool
+		std::size_t updaters;
+	};
+
+private:
+	struct Slab
+	{
+		LookupStorage storage;
+		// offset to size of free extents, adjacent extents are merged
+		std::map<Index, Index> free;
+	};
+
+	struct Service
+	{
+		Updater updater;
+		std::size_t slab;
+		Index offset;
+		// distinct reals of the service, to unregister them on destroy
+		std::vector<Real> reals;
+	};
+
+	StorageOptions options_;
+	std::size_t slab_cells_;
+	CountingResource usage_;
+	std::pmr::synchronized_pool_resource pool_{&usage_};
+	BasicUpdaterBuilder<Config> builder_;
+	BasicRingCache<Real, Config> ring_cache_;
+	std::vector<Slab> slabs_;
+	std::size_t used_cells_{};
+	std::vector<std::optional<Service>> services_;
+	std::vector<ServiceId> free_ids_;
+	std::map<Real, std::vector<Member>> members_;
+
+	std::optional<std::pair<std::size_t, Index>> Allocate(Index cells)
+	{
+		for (std::size_t s = 0; s < slabs_.size(); ++s)
+		{
+			auto& free = slabs_[s].free;
+			auto it = std::find_if(free.begin(), free.end(), [&](const auto& extent) {
+				return extent.second >= cells;
+			});
+			if (it == free.end())
+			{
+				continue;
+			}
+			auto [offset, size] = *it;
+			free.erase(it);
+			if (size != cells)
+			{
+				free.emplace(offset + cells, size - cells);
+			}
+			used_cells_ += cells;
+			return std::pair{s, offset};
+		}
+
+		std::size_t slab_cells = std::max<std::size_t>(slab_cells_, cells);
+		auto storage = LookupStorage::Allocate(slab_cells * sizeof(RealId), options_);
+		if (!storage)
+		{
+			return std::nullopt;
+		}
+		slabs_.push_back(Slab{std::move(storage.value()), {}});
+		if (slab_cells != cells)
+		{
+			slabs_.back().free.emplace(cells, slab_cells - cells);
+		}
+		used_cells_ += cells;
+		return std::pair{slabs_.size() - 1, Index{0}};
+	}
+
+	void Free(std::size_t slab, Index offset, Index cells)
+	{
+		used_cells_ -= cells;
+		auto& free = slabs_[slab].free;
+		auto next = free.lower_bound(offset);
+		if (next != free.end() && offset + cells == next->first)
+		{
+			cells += next->second;
+			next = free.erase(next);
+		}
+		if (next != free.begin())
+		{
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset)
+			{
+				prev->second += cells;
+				return;
+			}
+		}
+		free.emplace(offset, cells);
+	}
+
+	void Register(ServiceId id, const ServiceSpec& spec)
+	{
+		auto& reals = services_[id]->reals;
+		for (Index i = 0; i < spec.count; ++i)
+		{
+			auto& members = members_[spec.reals[i]];
+			if (members.empty() || members.back().service != id)
+			{
+				reals.push_back(spec.reals[i]);
+			}
+			// real repeated with the same id is one member
+			if (std::find_if(members.begin(), members.end(), [&](const Member& m) {
+				    return m.service == id && m.id == spec.ids[i];
+			    }) == members.end())
+			{
+				members.push_back(Member{id, spec.ids[i]});
+			}
+		}
+	}
+
+	void Unregister(ServiceId id, const Service& service)
+	{
+		for (const auto& real : service.reals)
+		{
+			auto it = members_.find(real);
+			auto& members = it->second;
+			members.erase(std::remove_if(members.begin(), members.end(), [&](const Member& m) {
+				              return m.service == id;
+			              }),
+			              members.end());
+			if (members.empty())
+			{
+				members_.erase(it);
+			}
+		}
+	}
+
+	RealId* LookupOf(const Service& service)
+	{
+		return slabs_[service.slab].storage.template As<RealId>() + service.offset;
+	}
+
+public:
+	/* @brief Side rings of up to \cached_rings rings are kept for services
+	 * with the same reals, each ring takes Config::DEFAULT_UNWEIGHTED_SIZE
+	 * cells.
+	 */
+	explicit BasicServiceRegistry(std::size_t slab_cells = DEFAULT_SLAB_CELLS,
+	                              const StorageOptions& options = {},
+	                              std::size_t cached_rings = 0) :
+	        options_{options},
+	        slab_cells_{slab_cells},
+	        ring_cache_(cached_rings)
+	{
+	}
+
+	BasicServiceRegistry(const BasicServiceRegistry&) = delete;
+	BasicServiceRegistry& operator=(const BasicServiceRegistry&) = delete;
+
+	/* @brief Builds a service and initializes its lookup. Returns
+	 * std::nullopt if the updater can't be built from \spec.
+	 */
+	std::optional<ServiceId> Create(const ServiceSpec& spec)
+	{
+		std::optional<ServiceId> id;
+		CreateBatch(&spec, 1, &id);
+		return id;
+	}
+
+	/* @brief Creates \count services, \out receives their ids. Updaters are
+	 * built one after another reusing the same scratch, lookups of the built
+	 * ones are initialized by up to \threads threads.
+	 */
+	void CreateBatch(const ServiceSpec* specs, std::size_t count, std::optional<ServiceId>* out, std::size_t threads = 1)
+	{
+		std::vector<ServiceId> created;
+		created.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			out[i] = std::nullopt;
+			const auto& spec = specs[i];
+			auto lookup_size = Updater::LookupRequiredSize(spec.count, spec.segments_per_weight);
+			auto updater = builder_.MakeWeightUpdater(spec.reals,
+			                                          spec.ids,
+			                                          spec.weights,
+			                                          spec.count,
+			                                          spec.side_rings_count,
+			                                          spec.segments_per_weight,
+			                                          lookup_size,
+			                                          &pool_,
+			                                          &ring_cache_);
+			if (!updater)
+			{
+				continue;
+			}
+			auto extent = Allocate(lookup_size);
+			if (!extent)
+			{
+				continue;
+			}
+
+			ServiceId id = services_.size();
+			if (!free_ids_.empty())
+			{
+				id = free_ids_.back();
+				free_ids_.pop_back();
+			}
+			else
+			{
+				services_.emplace_back();
+			}
+			services_[id].emplace(Service{std::move(updater.value()), extent->first, extent->second, {}});
+			Register(id, spec);
+			created.push_back(id);
+			out[i] = id;
+		}
+
+		ParallelFor(threads, created.size(), [&](std::size_t begin, std::size_t end) {
+			for (std::size_t k = begin; k < end; ++k)
+			{
+				auto& service = services_[created[k]].value();
+				service.updater.InitLookup(LookupOf(service));
+			}
+		});
+	}
+
+	/* @brief Applies \count updates. Updates of one service are applied in
+	 * order by one thread, different services are updated by up to \threads
+	 * threads. Updates of unknown services are ignored.
+	 */
+	void UpdateBatch(const ServiceUpdate* updates, std::size_t count, std::size_t threads = 1)
+	{
+		std::vector<std::size_t> order(count);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+			return updates[a].service < updates[b].service;
+		});
+		std::vector<std::size_t> groups;
+		for (std::size_t k = 0; k < count; ++k)
+		{
+			if (k == 0 || updates[order[k]].service != updates[order[k - 1]].service)
+			{
+				groups.push_back(k);
+			}
+		}
+		groups.push_back(count);
+
+		ParallelFor(threads, groups.size() - 1, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t g = begin; g < end; ++g)
+			{
+				ServiceId id = updates[order[groups[g]]].service;
+				if (id >= services_.size() || !services_[id])
+				{
+					continue;
+				}
+				auto& service = services_[id].value();
+				for (std::size_t k = groups[g]; k < groups[g + 1]; ++k)
+				{
+					const auto& update = updates[order[k]];
+					service.updater.UpdateLookup(update.ids, update.weights, update.count, LookupOf(service));
+				}
+			}
+		});
+	}
+
+	void Destroy(ServiceId id)
+	{
+		DestroyBatch(&id, 1);
+	}
+
+	void DestroyBatch(const ServiceId* ids, std::size_t count)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			if (ids[i] >= services_.size() || !services_[ids[i]])
+			{
+				continue;
+			}
+			auto& service = services_[ids[i]].value();
+			Free(service.slab, service.offset, service.updater.LookupSize());
+			Unregister(ids[i], service);
+			services_[ids[i]].reset();
+			free_ids_.push_back(ids[i]);
+		}
+	}
+
+	/* @brief Services \real belongs to, with its id in each of them.
+	 */
+	const std::vector<Member>& Members(const Real& real) const
+	{
+		static const std::vector<Member> none;
+		auto it = members_.find(real);
+		return it == members_.end() ? none : it->second;
+	}
+
+	/* @brief Sets weight of \real in every service it belongs to. Services
+	 * are updated by up to \threads threads. Returns cells repainted in all
+	 * services, ordered by service.
+	 */
+	std::vector<DirtyRange> SetRealWeight(const Real& real, Weight weight, std::size_t threads = 1)
+	{
+		std::vector<Member> members = Members(real);
+		std::stable_sort(members.begin(), members.end(), [](const Member& a, const Member& b) {
+			return a.service < b.service;
+		});
+		std::vector<std::size_t> groups;
+		for (std::size_t k = 0; k < members.size(); ++k)
+		{
+			if (k == 0 || members[k].service != members[k - 1].service)
+			{
+				groups.push_back(k);
+			}
+		}
+		std::vector<std::pmr::vector<Slice>> changes(groups.size());
+		groups.push_back(members.size());
+
+		ParallelFor(threads, changes.size(), [&](std::size_t begin, std::size_t end) {
+			for (std::size_t g = begin; g < end; ++g)
+			{
+				auto& service = services_[members[groups[g]].service].value();
+				for (std::size_t k = groups[g]; k < groups[g + 1]; ++k)
+				{
+					service.updater.UpdateLookup(&members[k].id, &weight, 1, LookupOf(service), changes[g]);
+				}
+			}
+		});
+
+		std::vector<DirtyRange> dirty;
+		for (std::size_t g = 0; g < changes.size(); ++g)
+		{
+			for (const auto& slice : changes[g])
+			{
+				dirty.push_back(DirtyRange{members[groups[g]].service, slice.start, slice.count});
+			}
+		}
+		return dirty;
+	}
+
+	bool Contains(ServiceId id) const
+	{
+		return id < services_.size() && services_[id];
+	}
+
+	const Updater* Find(ServiceId id) const
+	{
+		return Contains(id) ? &services_[id]->updater : nullptr;
+	}
+
+	/* @brief Lookup of service \id, nullptr for unknown services. Stays in
+	 * place until the service is destroyed.
+	 */
+	const RealId* Lookup(ServiceId id)
+	{
+		return Contains(id) ? LookupOf(services_[id].value()) : nullptr;
+	}
+
+	const BasicRingCache<Real, Config>& RingCache() const
+	{
+		return ring_cache_;
+	}
+
+	MemoryUsage Usage() const
+	{
+		MemoryUsage usage{services_.size() - free_ids_.size(), 0, used_cells_ * sizeof(RealId), usage_.bytes.load()};
+		for (const auto& slab : slabs_)
+		{
+			usage.slabs += slab.storage.Mapped();
+		}
+		return usage;
+	}
+};
+
+template<typename Real>
+using ServiceRegistry = BasicServiceRegistry<Real, DefaultConfig>;
+
+} // namespace chash
@@ -0,0 +1,147 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "chash.hpp"
+#include "storage.hpp"
+
+namespace chash
+{
+
+/* @brief Keeps copies of one lookup, e.g. one per NUMA node, up to date.
+ * The updater walks the first replica once on the calling thread and records
+ * painted slices, then every other replica gets only these slices written by
+ * its own writer thread, started with the replicas and pinned to the node of
+ * its replica. Readers of a replica see the same intermediate states as
+ * readers of a lookup updated with UpdateLookup, just later.
+ */
+template<typename Config = DefaultConfig>
+class BasicLookupReplicas
+{
+public:
+	using Updater = BasicWeightUpdater<Config>;
+	using Index = typename Config::Index;
+	using RealId = typename Config::RealId;
+	using Weight = typename Config::Weight;
+	using Slice = typename Updater::Slice;
+
+	struct Replica
+	{
+		RealId* lookup;
+		// node the writer is pinned to, any CPU if not set; the first replica
+		// is written by the caller of UpdateLookup, which should run there
+		std::optional<int> node;
+	};
+
+private:
+	std::vector<Replica> replicas_;
+	std::pmr::vector<Slice> changes_;
+
+	// writers wake up when generation_ changes and apply changes_
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::condition_variable done_;
+	std::uint64_t generation_{};
+	std::size_t writing_{};
+	bool stop_{};
+	std::vector<std::thread> writers_;
+
+	void Write(std::size_t r)
+	{
+		if (replicas_[r].node)
+		{
+			PinToNode(replicas_[r].node.value());
+		}
+		std::uint64_t seen{};
+		std::unique_lock lock(mutex_);
+		while (true)
+		{
+			wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+			if (stop_)
+			{
+				return;
+			}
+			seen = generation_;
+			lock.unlock();
+			Updater::ApplyChanges(changes_.data(), changes_.size(), replicas_[r].lookup);
+			lock.lock();
+			if (--writing_ == 0)
+			{
+				done_.notify_one();
+			}
+		}
+	}
+
+public:
+	/* @brief All \replicas must hold the same lookup of the updater that will
+	 * be passed to UpdateLookup.
+	 */
+	explicit BasicLookupReplicas(std::vector<Replica> replicas) :
+	        replicas_(std::move(replicas))
+	{
+		for (std::size_t r = 1; r < replicas_.size(); ++r)
+		{
+			writers_.emplace_back(&BasicLookupReplicas::Write, this, r);
+		}
+	}
+
+	BasicLookupReplicas(const BasicLookupReplicas&) = delete;
+	BasicLookupReplicas& operator=(const BasicLookupReplicas&) = delete;
+
+	~BasicLookupReplicas()
+	{
+		{
+			std::lock_guard lock(mutex_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		for (auto& writer : writers_)
+		{
+			writer.join();
+		}
+	}
+
+	const std::vector<Replica>& Replicas() const
+	{
+		return replicas_;
+	}
+
+	/* @brief Changes recorded by the last UpdateLookup.
+	 */
+	const std::pmr::vector<Slice>& Changes() const
+	{
+		return changes_;
+	}
+
+	void UpdateLookup(Updater& updater, const RealId* ids, const Weight* weights, Index count)
+	{
+		if (replicas_.empty())
+		{
+			return;
+		}
+		changes_.clear();
+		updater.UpdateLookup(ids, weights, count, replicas_[0].lookup, changes_);
+		if (writers_.empty())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard lock(mutex_);
+			writing_ = writers_.size();
+			++generation_;
+		}
+		wake_.notify_all();
+		std::unique_lock lock(mutex_);
+		done_.wait(lock, [&] { return writing_ == 0; });
+	}
+};
+
+using LookupReplicas = BasicLookupReplicas<DefaultConfig>;
+
+} // namespace chash
@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+#include "hash.hpp"
+#include "unweighted.hpp"
+
+namespace chash
+{
+
+/* @brief Side rings built for one real set. Rings depend on nothing but the
+ * reals in input order, the ring count and size, the salts drawn by
+ * Config::Rng and for every real the index of its first appearance.
+ */
+template<typename Real, typename Config>
+struct BasicRingSet
+{
+	using Index = typename Config::Index;
+
+	std::uint64_t fingerprint;
+	std::vector<Real> reals;
+	std::vector<Index> dense;
+	std::size_t size;
+	std::vector<Unweighted<Index>> rings;
+	// every real is in some ring, otherwise construction fails
+	bool covered;
+
+	bool Matches(const Real* other_reals, const Index* other_dense, std::size_t cnt, std::size_t count, std::size_t ring_size) const
+	{
+		return size == ring_size && rings.size() == count && reals.size() == cnt &&
+		       std::equal(reals.begin(), reals.end(), other_reals) &&
+		       std::equal(dense.begin(), dense.end(), other_dense);
+	}
+};
+
+/* @brief Keeps side rings of recently built real sets so that services with
+ * the same reals and rebuilds of a service skip building rings. Holds up to
+ * \capacity rings, least recently used sets are evicted first unless a maker
+ * still uses them. Not thread safe.
+ */
+template<typename Real, typename Config = DefaultConfig>
+class BasicRingCache
+{
+public:
+	using Index = typename Config::Index;
+	using RingSet = BasicRingSet<Real, Config>;
+
+	struct Stats
+	{
+		std::size_t hits;
+		std::size_t misses;
+		std::size_t evictions;
+	};
+
+private:
+	std::size_t capacity_;
+	std::size_t rings_{};
+	// most recently used first
+	std::list<std::shared_ptr<const RingSet>> sets_;
+	std::unordered_multimap<std::uint64_t, typename std::list<std::shared_ptr<const RingSet>>::iterator> index_;
+	Stats stats_{};
+
+	void Evict()
+	{
+		for (auto it = sets_.end(); rings_ > capacity_ && it != sets_.begin();)
+		{
+			--it;
+			// makers hold the other references
+			if (it->use_count() != 1)
+			{
+				continue;
+			}
+			auto [first, last] = index_.equal_range((*it)->fingerprint);
+			for (; first != last && first->second != it; ++first)
+			{
+			}
+			index_.erase(first);
+			rings_ -= (*it)->rings.size();
+			it = sets_.erase(it);
+			++stats_.evictions;
+		}
+	}
+
+public:
+	explicit BasicRingCache(std::size_t capacity) :
+	        capacity_{capacity}
+	{
+	}
+
+	static std::uint64_t Fingerprint(const Real* reals, const Index* dense, std::size_t cnt, std::size_t count, std::size_t size)
+	{
+		IdHash h = CalcHash(Config::RNG_SEED, CalcHash(count, CalcHash(size, 0)));
+		IdHash g = h;
+		for (std::size_t i = 0; i < cnt; ++i)
+		{
+			h = CalcHash(reals[i], h);
+			g = CalcHash(dense[i], g);
+		}
+		return (std::uint64_t{h} << 32) | g;
+	}
+
+	std::shared_ptr<const RingSet> Find(const Real* reals, const Index* dense, std::size_t cnt, std::size_t count, std::size_t size)
+	{
+		auto [first, last] = index_.equal_range(Fingerprint(reals, dense, cnt, count, size));
+		for (; first != last; ++first)
+		{
+			auto it = first->second;
+			if ((*it)->Matches(reals, dense, cnt, count, size))
+			{
+				sets_.splice(sets_.begin(), sets_, it);
+				++stats_.hits;
+				return *it;
+			}
+		}
+		++stats_.misses;
+		return nullptr;
+	}
+
+	std::shared_ptr<const RingSet> Insert(RingSet&& set)
+	{
+		auto shared = std::make_shared<const RingSet>(std::move(set));
+		if (shared->rings.size() > capacity_)
+		{
+			return shared;
+		}
+		sets_.push_front(shared);
+		index_.emplace(shared->fingerprint, sets_.begin());
+		rings_ += shared->rings.size();
+		Evict();
+		return shared;
+	}
+
+	std::size_t Rings() const
+	{
+		return rings_;
+	}
+
+	Stats Statistics() const
+	{
+		return stats_;
+	}
+};
+
+} // namespace chash
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <random>
+
+#include "hash.hpp"
+
+namespace chash
+{
+
+/* @brief Draws salts of side rings and hashes of heads from one std::mt19937.
+ * Hash of a head depends on every draw made before it, so heads have to be
+ * drawn one by one in order.
+ */
+class SequentialRng
+{
+	std::mt19937 seq_;
+
+public:
+	static constexpr bool INDEPENDENT = false;
+
+	explicit SequentialRng(std::mt19937::result_type seed) :
+	        seq_{seed}
+	{
+	}
+
+	Salt NextSalt()
+	{
+		return seq_();
+	}
+
+	IdHash Head(std::size_t /* index */)
+	{
+		return seq_();
+	}
+};
+
+/* @brief Draws salts of side rings from std::mt19937, same as SequentialRng,
+ * while hash of head \index is splitmix64 of the seed and the index only. Heads
+ * may be drawn in any order and from several threads and still produce the
+ * same updater.
+ */
+class CounterRng
+{
+	std::mt19937 seq_;
+	std::uint64_t seed_;
+
+public:
+	static constexpr bool INDEPENDENT = true;
+
+	explicit CounterRng(std::mt19937::result_type seed) :
+	        seq_{seed},
+	        seed_{seed}
+	{
+	}
+
+	Salt NextSalt()
+	{
+		return seq_();
+	}
+
+	IdHash Head(std::size_t index) const
+	{
+		std::uint64_t z = seed_ + (index + 1) * 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return static_cast<IdHash>((z ^ (z >> 31)) >> 32);
+	}
+};
+
+} // namespace chash
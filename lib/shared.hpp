@@ -0,0 +1,413 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+#include "chash.hpp"
+#include "hash.hpp"
+
+namespace chash
+{
+
+/* @brief Layout of updater state and lookup in a caller provided memory
+ * region, e.g. memfd or POSIX shared memory. Everything is addressed by
+ * offsets from the start of the region, so processes may map it at different
+ * addresses.
+ *
+ * SharedHeader is followed by 8-byte aligned sections: SharedReal records
+ * sorted by id, heads of all reals, enabled head count per real, enabled
+ * bits packed into 64-bit words and the lookup itself. Header, records and
+ * heads never change after creation and are covered by CRC32. Enabled
+ * counts, bits, active count and lookup change with every update.
+ */
+struct SharedHeader
+{
+	static constexpr char MAGIC[8] = {'C', 'H', 'A', 'S', 'H', 'S', 'H', 'M'};
+	static constexpr std::uint32_t VERSION = 1;
+
+	char magic[8];
+	std::uint32_t crc;
+	std::uint32_t version;
+	std::uint8_t real_id_size;
+	std::uint8_t index_size;
+	std::uint8_t weight_size;
+	std::uint8_t reserved[5];
+	std::uint64_t max_weight;
+	std::uint64_t lookup_size;
+	std::uint64_t segments_per_weight;
+	std::uint64_t real_count;
+	std::uint64_t heads_count;
+	std::uint64_t reals_offset;
+	std::uint64_t heads_offset;
+	std::uint64_t enabled_offset;
+	std::uint64_t bitmap_offset;
+	std::uint64_t lookup_offset;
+	std::uint64_t total_size;
+	// fields below change with updates and are not covered by crc
+	std::uint64_t active;
+	// accessed only through __atomic builtins once the region is published
+	std::uint64_t updating;
+	std::uint64_t generation;
+};
+
+struct SharedReal
+{
+	std::uint64_t id;
+	std::uint64_t first_head;
+	std::uint64_t heads;
+};
+
+/* @brief Updater which state and lookup live in a shared memory region.
+ * Dataplane reads the lookup in place with Lookup(region) and never copies
+ * it. Control plane keeps a private BasicWeightUpdater as a working copy,
+ * applies updates straight to the shared lookup and writes back enabled
+ * counts and bits of touched reals. Restarted control plane reattaches to
+ * the region and restores the working copy from it instead of rebuilding.
+ */
+template<typename Config = DefaultConfig>
+class BasicSharedUpdater
+{
+public:
+	using Updater = BasicWeightUpdater<Config>;
+	using Index = typename Config::Index;
+	using RealId = typename Config::RealId;
+	using Weight = typename Config::Weight;
+
+private:
+	static constexpr std::size_t CRC_START = offsetof(SharedHeader, crc) + sizeof(SharedHeader::crc);
+	static constexpr std::size_t CRC_END = offsetof(SharedHeader, active);
+
+	std::uint8_t* base_;
+	Updater updater_;
+
+	BasicSharedUpdater(std::uint8_t* base, Updater&& updater) :
+	        base_{base},
+	        updater_{std::move(updater)}
+	{
+	}
+
+	/* @brief updating flag may be read by another process attaching to the
+	 * region, so it is stored with release and loaded with acquire ordering.
+	 */
+	static std::uint64_t Updating(const SharedHeader& header)
+	{
+		return __atomic_load_n(&header.updating, __ATOMIC_ACQUIRE);
+	}
+
+	static void SetUpdating(SharedHeader& header, std::uint64_t updating)
+	{
+		__atomic_store_n(&header.updating, updating, __ATOMIC_RELEASE);
+	}
+
+	static std::uint64_t Align(std::uint64_t offset)
+	{
+		return (offset + 7) & ~std::uint64_t{7};
+	}
+
+	static void Place(SharedHeader& header)
+	{
+		header.reals_offset = Align(sizeof(SharedHeader));
+		header.heads_offset = Align(header.reals_offset + header.real_count * sizeof(SharedReal));
+		header.enabled_offset = Align(header.heads_offset + header.heads_count * sizeof(Index));
+		header.bitmap_offset = Align(header.enabled_offset + header.real_count * sizeof(std::uint64_t));
+		header.lookup_offset = Align(header.bitmap_offset + (header.lookup_size + 63) / 64 * sizeof(std::uint64_t));
+		header.total_size = Align(header.lookup_offset + header.lookup_size * sizeof(RealId));
+	}
+
+	/* @brief Checks that counts in \header can't take more than \size bytes
+	 * each, so that Place may multiply them without wrapping around.
+	 */
+	static bool Fits(const SharedHeader& header, std::size_t size)
+	{
+		return header.real_count <= size / (sizeof(SharedReal) + sizeof(std::uint64_t)) &&
+		       header.heads_count <= size / sizeof(Index) &&
+		       header.lookup_size <= size / sizeof(RealId);
+	}
+
+	static SharedHeader Layout(const Updater& updater)
+	{
+		SharedHeader header{};
+		std::memcpy(header.magic, SharedHeader::MAGIC, sizeof(header.magic));
+		header.version = SharedHeader::VERSION;
+		header.real_id_size = sizeof(RealId);
+		header.index_size = sizeof(Index);
+		header.weight_size = sizeof(Weight);
+		header.max_weight = Config::MaxWeight;
+		header.lookup_size = updater.lookup_size_;
+		header.segments_per_weight = updater.segments_per_weight_;
+		header.real_count = updater.heads_.size();
+		for (const auto& [id, info] : updater.heads_)
+		{
+			GCC_BUG_UNUSED(id);
+			header.heads_count += info.heads.size();
+		}
+		header.active = updater.active_;
+		Place(header);
+		return header;
+	}
+
+	static std::uint32_t Crc(const std::uint8_t* base, const SharedHeader& header)
+	{
+		std::uint32_t crc = crc32_fast(base + CRC_START, CRC_END - CRC_START);
+		return crc32_fast(base + header.reals_offset, header.enabled_offset - header.reals_offset, crc);
+	}
+
+	SharedHeader& Header() const
+	{
+		return *reinterpret_cast<SharedHeader*>(base_);
+	}
+
+	SharedReal* Reals() const
+	{
+		return reinterpret_cast<SharedReal*>(base_ + Header().reals_offset);
+	}
+
+	std::uint64_t* EnabledCounts() const
+	{
+		return reinterpret_cast<std::uint64_t*>(base_ + Header().enabled_offset);
+	}
+
+	std::uint64_t* Bitmap() const
+	{
+		return reinterpret_cast<std::uint64_t*>(base_ + Header().bitmap_offset);
+	}
+
+	void StoreBit(Index pos)
+	{
+		std::uint64_t& word = Bitmap()[pos / 64];
+		std::uint64_t mask = std::uint64_t{1} << (pos % 64);
+		word = updater_.enabled_[pos] ? (word | mask) : (word & ~mask);
+	}
+
+	/* @brief Copies enabled count of \id and bits of its heads switched
+	 * since it had \was heads enabled to the region.
+	 */
+	void StoreReal(RealId id, Index was)
+	{
+		const SharedHeader& header = Header();
+		SharedReal* reals = Reals();
+		SharedReal* real = std::lower_bound(reals, reals + header.real_count, id, [](const SharedReal& r, RealId id) {
+			return r.id < id;
+		});
+		const auto& info = updater_.heads_.at(id);
+		EnabledCounts()[real - reals] = info.enabled;
+		for (Index i = std::min(was, info.enabled); i < std::max(was, info.enabled); ++i)
+		{
+			StoreBit(info.heads[i]);
+		}
+	}
+
+public:
+	static std::size_t RequiredSize(const Updater& updater)
+	{
+		return Layout(updater).total_size;
+	}
+
+	/* @brief Lays out state of \updater in \region of \size bytes, which
+	 * must be 8-byte aligned, and initializes lookup there.
+	 */
+	static std::optional<BasicSharedUpdater> Create(Updater&& updater, void* region, std::size_t size)
+	{
+		SharedHeader header = Layout(updater);
+		if (header.total_size > size)
+		{
+			return std::nullopt;
+		}
+		auto* base = static_cast<std::uint8_t*>(region);
+		std::memset(base, 0, header.lookup_offset);
+		header.updating = 1;
+		std::memcpy(base, &header, sizeof(header));
+
+		BasicSharedUpdater shared(base, std::move(updater));
+		std::vector<RealId> ids;
+		ids.reserve(header.real_count);
+		for (const auto& [id, info] : shared.updater_.heads_)
+		{
+			GCC_BUG_UNUSED(info);
+			ids.push_back(id);
+		}
+		std::sort(ids.begin(), ids.end());
+
+		std::uint64_t first{};
+		for (std::size_t i = 0; i < ids.size(); ++i)
+		{
+			const auto& info = shared.updater_.heads_.at(ids[i]);
+			shared.Reals()[i] = SharedReal{ids[i], first, info.heads.size()};
+			shared.EnabledCounts()[i] = info.enabled;
+			std::memcpy(base + header.heads_offset + first * sizeof(Index),
+			            info.heads.data(),
+			            info.heads.size() * sizeof(Index));
+			first += info.heads.size();
+		}
+		for (Index pos = 0; pos < header.lookup_size; ++pos)
+		{
+			shared.StoreBit(pos);
+		}
+		shared.updater_.InitLookup(shared.Lookup());
+
+		SharedHeader& stored = shared.Header();
+		stored.crc = Crc(base, stored);
+		SetUpdating(stored, 0);
+		return shared;
+	}
+
+	/* @brief Validates region created by Create and restores working copy
+	 * of the updater from it, allocating from \resource. If previous owner
+	 * died in the middle of an update, lookup is rebuilt from enabled counts
+	 * found in the region.
+	 */
+	static std::optional<BasicSharedUpdater> Attach(void* region,
+	                                                std::size_t size,
+	                                                std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+	{
+		auto* base = static_cast<std::uint8_t*>(region);
+		if (size < sizeof(SharedHeader))
+		{
+			return std::nullopt;
+		}
+		std::uint64_t updating = Updating(*reinterpret_cast<const SharedHeader*>(base));
+		SharedHeader header;
+		std::memcpy(&header, base, sizeof(header));
+		if (!Fits(header, size))
+		{
+			return std::nullopt;
+		}
+		SharedHeader expected = header;
+		Place(expected);
+		if (std::memcmp(header.magic, SharedHeader::MAGIC, sizeof(header.magic)) != 0 ||
+		    header.version != SharedHeader::VERSION ||
+		    header.real_id_size != sizeof(RealId) ||
+		    header.index_size != sizeof(Index) ||
+		    header.weight_size != sizeof(Weight) ||
+		    header.max_weight != Config::MaxWeight ||
+		    header.lookup_size > std::numeric_limits<Index>::max() ||
+		    std::memcmp(&expected, &header, sizeof(header)) != 0 ||
+		    header.total_size > size ||
+		    Crc(base, header) != header.crc)
+		{
+			return std::nullopt;
+		}
+
+		BasicSharedUpdater shared(base, Updater(header.segments_per_weight, header.lookup_size, resource));
+		Updater& updater = shared.updater_;
+		updater.active_ = header.active;
+		updater.heads_.reserve(header.real_count);
+		for (std::size_t i = 0; i < header.real_count; ++i)
+		{
+			const SharedReal& real = shared.Reals()[i];
+			std::uint64_t enabled = shared.EnabledCounts()[i];
+			if ((i != 0 && real.id <= shared.Reals()[i - 1].id) ||
+			    real.first_head > header.heads_count ||
+			    real.heads > header.heads_count - real.first_head ||
+			    enabled > real.heads)
+			{
+				return std::nullopt;
+			}
+			auto& info = updater.heads_[real.id];
+			info.enabled = enabled;
+			const Index* heads = reinterpret_cast<const Index*>(base + header.heads_offset) + real.first_head;
+			info.heads.assign(heads, heads + real.heads);
+			if (std::any_of(info.heads.begin(), info.heads.end(), [&](Index pos) {
+				    return pos >= header.lookup_size;
+			    }))
+			{
+				return std::nullopt;
+			}
+		}
+
+		if (updating == 0)
+		{
+			for (Index pos = 0; pos < header.lookup_size; ++pos)
+			{
+				updater.enabled_[pos] = (shared.Bitmap()[pos / 64] >> (pos % 64)) & 1;
+			}
+			return shared;
+		}
+
+		updater.active_ = 0;
+		for (auto& [id, info] : updater.heads_)
+		{
+			GCC_BUG_UNUSED(id);
+			std::for_each(info.heads.begin(), info.heads.begin() + info.enabled, [&](Index pos) {
+				updater.enabled_[pos] = true;
+			});
+			updater.active_ += info.enabled != 0;
+		}
+		for (Index pos = 0; pos < header.lookup_size; ++pos)
+		{
+			shared.StoreBit(pos);
+		}
+		updater.InitLookup(shared.Lookup());
+		shared.Header().active = updater.active_;
+		SetUpdating(shared.Header(), 0);
+		return shared;
+	}
+
+	/* @brief Lookup of a region created by Create, for readers which only
+	 * map the region.
+	 */
+	static const RealId* Lookup(const void* region)
+	{
+		const auto* base = static_cast<const std::uint8_t*>(region);
+		return reinterpret_cast<const RealId*>(base + reinterpret_cast<const SharedHeader*>(base)->lookup_offset);
+	}
+
+	static Index LookupSize(const void* region)
+	{
+		return reinterpret_cast<const SharedHeader*>(region)->lookup_size;
+	}
+
+	RealId* Lookup()
+	{
+		return reinterpret_cast<RealId*>(base_ + Header().lookup_offset);
+	}
+
+	Index LookupSize() const
+	{
+		return updater_.LookupSize();
+	}
+
+	/* @brief Number of updates applied to the region since its creation.
+	 */
+	std::uint64_t Generation() const
+	{
+		return Header().generation;
+	}
+
+	const Updater& Local() const
+	{
+		return updater_;
+	}
+
+	void UpdateWeight(RealId id, Weight weight)
+	{
+		UpdateLookup(&id, &weight, 1);
+	}
+
+	void UpdateLookup(const RealId* ids, const Weight* weights, Index count)
+	{
+		SharedHeader& header = Header();
+		SetUpdating(header, 1);
+		// keeps writes to the lookup below from becoming visible before the flag
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		for (Index i = 0; i < count; ++i)
+		{
+			auto info = updater_.heads_.find(ids[i]);
+			if (info == updater_.heads_.end())
+			{
+				continue;
+			}
+			Index was = info->second.enabled;
+			updater_.UpdateWeight(ids[i], weights[i], Lookup());
+			StoreReal(ids[i], was);
+		}
+		header.active = updater_.active_;
+		++header.generation;
+		SetUpdating(header, 0);
+	}
+};
+
+using SharedUpdater = BasicSharedUpdater<DefaultConfig>;
+
+} // namespace chash
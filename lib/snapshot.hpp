@@ -0,0 +1,273 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#include "chash.hpp"
+#include "hash.hpp"
+
+namespace chash
+{
+
+/* @brief Binary snapshot of BasicWeightUpdater state: heads of every real,
+ * enabled bits, active count and lookup size. Restoring a snapshot skips
+ * building rings and distributing heads, so it can be used for fast restart
+ * from a memory mapped file.
+ *
+ * Layout is a SnapshotHeader followed by sections at 8-byte aligned offsets:
+ * SnapshotReal records sorted by id, heads of all reals as Index values and
+ * enabled bits packed into 64-bit words. All fields are in host byte order.
+ * CRC32 covers everything past the crc field up to total_size.
+ */
+struct SnapshotHeader
+{
+	static constexpr char MAGIC[8] = {'C', 'H', 'A', 'S', 'H', 'S', 'N', 'P'};
+	static constexpr std::uint32_t VERSION = 1;
+
+	char magic[8];
+	std::uint32_t crc;
+	std::uint32_t version;
+	std::uint8_t real_id_size;
+	std::uint8_t index_size;
+	std::uint8_t weight_size;
+	std::uint8_t reserved[5];
+	std::uint64_t max_weight;
+	std::uint64_t lookup_size;
+	std::uint64_t segments_per_weight;
+	std::uint64_t active;
+	std::uint64_t real_count;
+	std::uint64_t heads_count;
+	std::uint64_t reals_offset;
+	std::uint64_t heads_offset;
+	std::uint64_t bitmap_offset;
+	std::uint64_t total_size;
+};
+
+struct SnapshotReal
+{
+	std::uint64_t id;
+	std::uint64_t enabled;
+	std::uint64_t first_head;
+	std::uint64_t heads;
+};
+
+template<typename Config = DefaultConfig>
+class BasicSnapshot
+{
+public:
+	using Updater = BasicWeightUpdater<Config>;
+	using Index = typename Config::Index;
+	using RealId = typename Config::RealId;
+
+private:
+	static constexpr std::size_t CRC_START = offsetof(SnapshotHeader, crc) + sizeof(SnapshotHeader::crc);
+
+	static std::uint64_t Align(std::uint64_t offset)
+	{
+		return (offset + 7) & ~std::uint64_t{7};
+	}
+
+	static SnapshotHeader Layout(const Updater& updater)
+	{
+		SnapshotHeader header{};
+		std::memcpy(header.magic, SnapshotHeader::MAGIC, sizeof(header.magic));
+		header.version = SnapshotHeader::VERSION;
+		header.real_id_size = sizeof(RealId);
+		header.index_size = sizeof(Index);
+		header.weight_size = sizeof(typename Config::Weight);
+		header.max_weight = Config::MaxWeight;
+		header.lookup_size = updater.lookup_size_;
+		header.segments_per_weight = updater.segments_per_weight_;
+		header.active = updater.active_;
+		header.real_count = updater.heads_.size();
+		for (const auto& [id, info] : updater.heads_)
+		{
+			GCC_BUG_UNUSED(id);
+			header.heads_count += info.heads.size();
+		}
+		header.reals_offset = Align(sizeof(SnapshotHeader));
+		header.heads_offset = Align(header.reals_offset + header.real_count * sizeof(SnapshotReal));
+		header.bitmap_offset = Align(header.heads_offset + header.heads_count * sizeof(Index));
+		header.total_size = header.bitmap_offset + (header.lookup_size + 63) / 64 * sizeof(std::uint64_t);
+		return header;
+	}
+
+public:
+	static std::size_t Size(const Updater& updater)
+	{
+		return Layout(updater).total_size;
+	}
+
+	/* @brief Writes snapshot of \updater to \out which must have room for
+	 * Size(updater) bytes.
+	 */
+	static void Serialize(const Updater& updater, void* out)
+	{
+		auto* base = static_cast<std::uint8_t*>(out);
+		SnapshotHeader header = Layout(updater);
+		std::memset(base, 0, header.total_size);
+
+		std::vector<RealId> ids;
+		ids.reserve(updater.heads_.size());
+		for (const auto& [id, info] : updater.heads_)
+		{
+			GCC_BUG_UNUSED(info);
+			ids.push_back(id);
+		}
+		std::sort(ids.begin(), ids.end());
+
+		std::uint64_t first{};
+		for (std::size_t i = 0; i < ids.size(); ++i)
+		{
+			const auto& info = updater.heads_.at(ids[i]);
+			SnapshotReal real{ids[i], info.enabled, first, info.heads.size()};
+			std::memcpy(base + header.reals_offset + i * sizeof(SnapshotReal), &real, sizeof(real));
+			std::memcpy(base + header.heads_offset + first * sizeof(Index),
+			            info.heads.data(),
+			            info.heads.size() * sizeof(Index));
+			first += info.heads.size();
+		}
+
+		for (std::size_t word = 0; word * 64 < header.lookup_size; ++word)
+		{
+			std::uint64_t bits{};
+			for (std::size_t bit = 0; bit < 64 && word * 64 + bit < header.lookup_size; ++bit)
+			{
+				bits |= std::uint64_t{updater.enabled_[word * 64 + bit]} << bit;
+			}
+			std::memcpy(base + header.bitmap_offset + word * sizeof(bits), &bits, sizeof(bits));
+		}
+
+		std::memcpy(base, &header, sizeof(header));
+		header.crc = crc32_fast(base + CRC_START, header.total_size - CRC_START);
+		std::memcpy(base, &header, sizeof(header));
+	}
+
+	static std::vector<std::uint8_t> Serialize(const Updater& updater)
+	{
+		std::vector<std::uint8_t> result(Size(updater));
+		Serialize(updater, result.data());
+		return result;
+	}
+
+	/* @brief Validates snapshot in \data of \size bytes and restores updater
+	 * from it, allocating from \resource. Returns std::nullopt if snapshot is
+	 * truncated, corrupted, made for another version or Config, or if its
+	 * active count or enabled bits disagree with the heads of its reals.
+	 */
+	static std::optional<Updater> Load(const void* data,
+	                                   std::size_t size,
+	                                   std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+	{
+		const auto* base = static_cast<const std::uint8_t*>(data);
+		SnapshotHeader header;
+		if (size < sizeof(header))
+		{
+			return std::nullopt;
+		}
+		std::memcpy(&header, base, sizeof(header));
+
+		if (std::memcmp(header.magic, SnapshotHeader::MAGIC, sizeof(header.magic)) != 0 ||
+		    header.version != SnapshotHeader::VERSION ||
+		    header.real_id_size != sizeof(RealId) ||
+		    header.index_size != sizeof(Index) ||
+		    header.weight_size != sizeof(typename Config::Weight) ||
+		    header.max_weight != Config::MaxWeight ||
+		    header.lookup_size > std::numeric_limits<Index>::max() ||
+		    header.total_size > size ||
+		    header.total_size < sizeof(header))
+		{
+			return std::nullopt;
+		}
+
+		// counts are checked against the room left before they are
+		// multiplied, so crafted ones can't wrap offsets around
+		SnapshotHeader expected = header;
+		expected.reals_offset = Align(sizeof(SnapshotHeader));
+		if (expected.reals_offset > header.total_size ||
+		    header.real_count > (header.total_size - expected.reals_offset) / sizeof(SnapshotReal))
+		{
+			return std::nullopt;
+		}
+		expected.heads_offset = Align(expected.reals_offset + header.real_count * sizeof(SnapshotReal));
+		if (expected.heads_offset > header.total_size ||
+		    header.heads_count > (header.total_size - expected.heads_offset) / sizeof(Index))
+		{
+			return std::nullopt;
+		}
+		expected.bitmap_offset = Align(expected.heads_offset + header.heads_count * sizeof(Index));
+		expected.total_size = expected.bitmap_offset + (header.lookup_size + 63) / 64 * sizeof(std::uint64_t);
+		if (std::memcmp(&expected, &header, sizeof(header)) != 0 ||
+		    crc32_fast(base + CRC_START, header.total_size - CRC_START) != header.crc)
+		{
+			return std::nullopt;
+		}
+
+		Updater updater(header.segments_per_weight, header.lookup_size, resource);
+		updater.heads_.reserve(header.real_count);
+		std::uint64_t previous{};
+		for (std::size_t i = 0; i < header.real_count; ++i)
+		{
+			SnapshotReal real;
+			std::memcpy(&real, base + header.reals_offset + i * sizeof(SnapshotReal), sizeof(real));
+			// ids are stored sorted, so a repeated or truncated id is corruption
+			if (real.id > std::numeric_limits<RealId>::max() ||
+			    (i != 0 && real.id <= previous) ||
+			    real.first_head > header.heads_count ||
+			    real.heads > header.heads_count - real.first_head ||
+			    real.enabled > real.heads)
+			{
+				return std::nullopt;
+			}
+			previous = real.id;
+			auto& info = updater.heads_[real.id];
+			info.enabled = real.enabled;
+			info.heads.resize(real.heads);
+			std::memcpy(info.heads.data(),
+			            base + header.heads_offset + real.first_head * sizeof(Index),
+			            real.heads * sizeof(Index));
+			if (std::any_of(info.heads.begin(), info.heads.end(), [&](Index pos) {
+				    return pos >= header.lookup_size;
+			    }))
+			{
+				return std::nullopt;
+			}
+			// enabled heads own their positions, so two reals can't share one
+			for (Index h = 0; h < info.enabled; ++h)
+			{
+				if (updater.enabled_[info.heads[h]])
+				{
+					return std::nullopt;
+				}
+				updater.enabled_[info.heads[h]] = true;
+			}
+			updater.active_ += info.enabled != 0;
+		}
+
+		// active count and bitmap are derived from the reals, a stored copy
+		// that disagrees with them would break later updates
+		if (header.active != updater.active_)
+		{
+			return std::nullopt;
+		}
+		for (std::size_t word = 0; word * 64 < header.lookup_size; ++word)
+		{
+			std::uint64_t bits;
+			std::memcpy(&bits, base + header.bitmap_offset + word * sizeof(bits), sizeof(bits));
+			for (std::size_t bit = 0; bit < 64 && word * 64 + bit < header.lookup_size; ++bit)
+			{
+				if (((bits >> bit) & 1) != updater.enabled_[word * 64 + bit])
+				{
+					return std::nullopt;
+				}
+			}
+		}
+		return updater;
+	}
+};
+
+using Snapshot = BasicSnapshot<DefaultConfig>;
+
+} // namespace chash
@@ -0,0 +1,245 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory_resource>
+
+namespace chash
+{
+
+/* @brief Log-linear histogram of non-negative values, e.g. nanoseconds:
+ * values below 16 are exact, larger ones fall into 16 buckets per power of
+ * two, so any percentile is off by at most 1/16.
+ */
+class Histogram
+{
+	static constexpr std::size_t SUB = 16;
+	static constexpr std::size_t SUB_BITS = 4;
+	std::array<std::uint64_t, 64 * SUB> counts_{};
+	std::uint64_t total_{};
+	std::uint64_t max_{};
+
+	static std::size_t Bucket(std::uint64_t value)
+	{
+		if (value < SUB)
+		{
+			return value;
+		}
+		std::size_t p = 63 - __builtin_clzll(value);
+		return (p - SUB_BITS + 1) * SUB + ((value >> (p - SUB_BITS)) & (SUB - 1));
+	}
+
+	static std::uint64_t Lower(std::size_t bucket)
+	{
+		if (bucket < SUB)
+		{
+			return bucket;
+		}
+		std::size_t p = bucket / SUB + SUB_BITS - 1;
+		return (std::uint64_t{1} << p) | (std::uint64_t{bucket % SUB} << (p - SUB_BITS));
+	}
+
+public:
+	void Add(std::uint64_t value)
+	{
+		++counts_[Bucket(value)];
+		++total_;
+		max_ = std::max(max_, value);
+	}
+
+	void Merge(const Histogram& other)
+	{
+		for (std::size_t i = 0; i < counts_.size(); ++i)
+		{
+			counts_[i] += other.counts_[i];
+		}
+		total_ += other.total_;
+		max_ = std::max(max_, other.max_);
+	}
+
+	/* @brief Lower bound of the bucket holding \p-th quantile, 0 <= p <= 1.
+	 */
+	std::uint64_t Percentile(double p) const
+	{
+		auto rank = std::max<std::uint64_t>(static_cast<std::uint64_t>(std::ceil(p * total_)), 1);
+		std::uint64_t seen{};
+		for (std::size_t i = 0; i < counts_.size(); ++i)
+		{
+			seen += counts_[i];
+			if (seen >= rank)
+			{
+				return Lower(i);
+			}
+		}
+		return max_;
+	}
+
+	std::uint64_t Max() const
+	{
+		return max_;
+	}
+
+	std::uint64_t Total() const
+	{
+		return total_;
+	}
+};
+
+enum class Operation
+{
+	MAKE,
+	INIT_LOOKUP,
+	UPDATE_WEIGHT,
+	UPDATE_LOOKUP,
+	SET_WEIGHTS,
+	COUNT
+};
+
+/* @brief Default Config::Stats, every hook is empty and compiles away.
+ */
+struct NullStats
+{
+	static constexpr bool ENABLED = false;
+
+	void SliceEnabled()
+	{
+	}
+
+	void SliceDisabled()
+	{
+	}
+
+	void Walk(std::size_t /* cells */)
+	{
+	}
+
+	void RebalanceMoved(std::size_t /* heads */)
+	{
+	}
+
+	void Latency(Operation /* operation */, std::uint64_t /* ns */)
+	{
+	}
+};
+
+/* @brief Config::Stats counting what updaters do. Set it in a config to
+ * export counters and histograms, e.g.
+ * struct Config : DefaultConfig { using Stats = UpdaterStats; };
+ */
+struct UpdaterStats
+{
+	static constexpr bool ENABLED = true;
+
+	std::uint64_t slices_enabled{};
+	std::uint64_t slices_disabled{};
+	// cells repainted by ColorSlice, walk length is cells per call
+	std::uint64_t cells_written{};
+	Histogram walk;
+	std::uint64_t rebalance_moves{};
+	// nanoseconds per call of each Operation
+	std::array<Histogram, static_cast<std::size_t>(Operation::COUNT)> latency;
+
+	void SliceEnabled()
+	{
+		++slices_enabled;
+	}
+
+	void SliceDisabled()
+	{
+		++slices_disabled;
+	}
+
+	void Walk(std::size_t cells)
+	{
+		cells_written += cells;
+		walk.Add(cells);
+	}
+
+	void RebalanceMoved(std::size_t heads)
+	{
+		rebalance_moves += heads;
+	}
+
+	void Latency(Operation operation, std::uint64_t ns)
+	{
+		latency[static_cast<std::size_t>(operation)].Add(ns);
+	}
+
+	const Histogram& Of(Operation operation) const
+	{
+		return latency[static_cast<std::size_t>(operation)];
+	}
+};
+
+/* @brief Reports time from construction to destruction as latency of
+ * \operation, does nothing unless \Stats is enabled.
+ */
+template<typename Stats>
+class ScopedLatency
+{
+	Stats& stats_;
+	Operation operation_;
+	std::chrono::steady_clock::time_point start_;
+
+public:
+	ScopedLatency(Stats& stats, Operation operation) :
+	        stats_{stats},
+	        operation_{operation}
+	{
+		if constexpr (Stats::ENABLED)
+		{
+			start_ = std::chrono::steady_clock::now();
+		}
+	}
+
+	~ScopedLatency()
+	{
+		if constexpr (Stats::ENABLED)
+		{
+			auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+			stats_.Latency(operation_, ns.count());
+		}
+	}
+};
+
+
+/* @brief Passes allocations to \upstream, counting them and bytes currently
+ * allocated. Counters may be read and reset while other threads allocate.
+ */
+class CountingResource : public std::pmr::memory_resource
+{
+	std::pmr::memory_resource* upstream_;
+
+public:
+	std::atomic<std::size_t> allocations{};
+	std::atomic<std::size_t> bytes{};
+
+	explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) :
+	        upstream_{upstream}
+	{
+	}
+
+private:
+	void* do_allocate(std::size_t size, std::size_t alignment) override
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		bytes.fetch_add(size, std::memory_order_relaxed);
+		return upstream_->allocate(size, alignment);
+	}
+
+	void do_deallocate(void* p, std::size_t size, std::size_t alignment) override
+	{
+		bytes.fetch_sub(size, std::memory_order_relaxed);
+		upstream_->deallocate(p, size, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+} // namespace chash
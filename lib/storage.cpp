@@ -0,0 +1,176 @@
+#include "storage.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace chash
+{
+
+namespace
+{
+
+// from linux/mempolicy.h, not every libc ships numaif.h
+constexpr int MPOL_BIND_MODE = 2;
+constexpr unsigned MPOL_MF_MOVE_FLAG = 1u << 1;
+constexpr std::size_t MAX_NODES = 1024;
+
+std::size_t RoundUp(std::size_t size, std::size_t to)
+{
+	return (size + to - 1) / to * to;
+}
+
+bool Bind(void* data, std::size_t size, int node)
+{
+#ifdef SYS_mbind
+	constexpr std::size_t BITS = sizeof(unsigned long) * 8;
+	if (node < 0 || static_cast<std::size_t>(node) >= MAX_NODES)
+	{
+		return false;
+	}
+	unsigned long mask[MAX_NODES / BITS]{};
+	mask[node / BITS] = 1ul << (node % BITS);
+	return syscall(SYS_mbind, data, size, MPOL_BIND_MODE, mask, MAX_NODES, MPOL_MF_MOVE_FLAG) == 0;
+#else
+	GCC_BUG_UNUSED(data);
+	GCC_BUG_UNUSED(size);
+	GCC_BUG_UNUSED(node);
+	return false;
+#endif
+}
+
+} // namespace
+
+bool PinToNode(int node)
+{
+	// cpulist looks like "0-3,8-11"
+	std::ifstream list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+	std::string ranges;
+	if (node < 0 || !std::getline(list, ranges))
+	{
+		return false;
+	}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	std::istringstream in(ranges);
+	for (std::string range; std::getline(in, range, ',');)
+	{
+		if (range.empty())
+		{
+			continue;
+		}
+		auto dash = range.find('-');
+		int first = std::stoi(range.substr(0, dash));
+		int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+		for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+		{
+			CPU_SET(cpu, &set);
+		}
+	}
+	return CPU_COUNT(&set) != 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+std::optional<LookupStorage> LookupStorage::Allocate(std::size_t size, const StorageOptions& options)
+{
+	LookupStorage storage;
+	storage.size_ = size;
+	storage.mapped_ = RoundUp(std::max<std::size_t>(size, 1), HUGE_PAGE);
+
+	void* data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	if (options.hugepages)
+	{
+		data = mmap(nullptr, storage.mapped_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		storage.hugetlb_ = data != MAP_FAILED;
+	}
+#endif
+	if (data == MAP_FAILED)
+	{
+		// no hugetlb pool, map extra huge page to align start for THP
+		std::size_t length = storage.mapped_ + HUGE_PAGE;
+		auto* raw = static_cast<char*>(mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+		if (raw == MAP_FAILED)
+		{
+			return std::nullopt;
+		}
+		auto* aligned = reinterpret_cast<char*>(RoundUp(reinterpret_cast<std::uintptr_t>(raw), HUGE_PAGE));
+		if (aligned != raw)
+		{
+			munmap(raw, aligned - raw);
+		}
+		std::size_t tail = raw + length - (aligned + storage.mapped_);
+		if (tail != 0)
+		{
+			munmap(aligned + storage.mapped_, tail);
+		}
+		data = aligned;
+#ifdef MADV_HUGEPAGE
+		if (options.hugepages)
+		{
+			madvise(data, storage.mapped_, MADV_HUGEPAGE);
+		}
+#endif
+	}
+	storage.data_ = data;
+
+	// policy must be set before pages are touched
+	if (options.node)
+	{
+		storage.bound_ = Bind(storage.data_, storage.mapped_, options.node.value());
+	}
+	std::memset(storage.data_, 0, storage.mapped_);
+	if (options.lock)
+	{
+		storage.locked_ = mlock(storage.data_, storage.mapped_) == 0;
+	}
+	return storage;
+}
+
+LookupStorage::LookupStorage(LookupStorage&& other) noexcept :
+        data_{std::exchange(other.data_, nullptr)},
+        size_{std::exchange(other.size_, 0)},
+        mapped_{std::exchange(other.mapped_, 0)},
+        hugetlb_{other.hugetlb_},
+        bound_{other.bound_},
+        locked_{other.locked_}
+{
+}
+
+LookupStorage& LookupStorage::operator=(LookupStorage&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (data_ != nullptr)
+		{
+			munmap(data_, mapped_);
+		}
+		data_ = std::exchange(other.data_, nullptr);
+		size_ = std::exchange(other.size_, 0);
+		mapped_ = std::exchange(other.mapped_, 0);
+		hugetlb_ = other.hugetlb_;
+		bound_ = other.bound_;
+		locked_ = other.locked_;
+	}
+	return *this;
+}
+
+LookupStorage::~LookupStorage()
+{
+	if (data_ != nullptr)
+	{
+		munmap(data_, mapped_);
+	}
+}
+
+} // namespace chash
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+
+#include "chash.hpp"
+
+namespace chash
+{
+
+struct StorageOptions
+{
+	// try MAP_HUGETLB first, then transparent huge pages
+	bool hugepages = true;
+	// lock pages in memory, failure (e.g. RLIMIT_MEMLOCK) is not fatal
+	bool lock = false;
+	// NUMA node to bind pages to, failure is not fatal
+	std::optional<int> node;
+};
+
+/* @brief Page aligned anonymous memory for lookups read randomly at line
+ * rate. Pages are huge when the host allows it, bound to the requested NUMA
+ * node and prefaulted, so the first packets don't pay for page faults.
+ * Everything but the mapping itself is best effort, see accessors for what
+ * was actually achieved.
+ */
+class LookupStorage
+{
+public:
+	static constexpr std::size_t HUGE_PAGE = 2u << 20;
+
+private:
+	void* data_{};
+	std::size_t size_{};
+	std::size_t mapped_{};
+	bool hugetlb_{};
+	bool bound_{};
+	bool locked_{};
+
+	LookupStorage() = default;
+
+public:
+	/* @brief Maps at least \size bytes. Returns std::nullopt only if no memory
+	 * could be mapped at all.
+	 */
+	static std::optional<LookupStorage> Allocate(std::size_t size, const StorageOptions& options = {});
+
+	LookupStorage(LookupStorage&& other) noexcept;
+	LookupStorage& operator=(LookupStorage&& other) noexcept;
+	LookupStorage(const LookupStorage&) = delete;
+	LookupStorage& operator=(const LookupStorage&) = delete;
+	~LookupStorage();
+
+	void* Data() const
+	{
+		return data_;
+	}
+
+	template<typename T>
+	T* As() const
+	{
+		return static_cast<T*>(data_);
+	}
+
+	std::size_t Size() const
+	{
+		return size_;
+	}
+
+	// length of the mapping, Size() rounded up to whole huge pages
+	std::size_t Mapped() const
+	{
+		return mapped_;
+	}
+
+	// pages come from the hugetlb pool rather than transparent huge pages
+	bool HugeTlb() const
+	{
+		return hugetlb_;
+	}
+
+	bool Bound() const
+	{
+		return bound_;
+	}
+
+	bool Locked() const
+	{
+		return locked_;
+	}
+};
+
+/* @brief Restricts the calling thread to CPUs of NUMA \node. Returns false
+ * and leaves affinity intact if the node is unknown.
+ */
+bool PinToNode(int node);
+
+/* @brief Allocates storage for the lookup of \updater and initializes the
+ * lookup right in it.
+ */
+template<typename Config>
+std::optional<LookupStorage> MakeLookupStorage(const BasicWeightUpdater<Config>& updater,
+                                               const StorageOptions& options = {})
+{
+	using RealId = typename Config::RealId;
+	auto storage = LookupStorage::Allocate(updater.LookupSize() * sizeof(RealId), options);
+	if (storage)
+	{
+		updater.InitLookup(storage->template As<RealId>());
+	}
+	return storage;
+}
+
+} // namespace chash
@@ -0,0 +1,314 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include "chash.hpp"
+
+namespace chash
+{
+
+/* @brief Stores lookups by content. Services with the same input share one
+ * read-only table, an update of a shared table detaches a private copy first
+ * and a table that becomes equal to a stored one is shared again. Content
+ * hash is a sum over cells, so updates adjust it from painted slices instead
+ * of hashing the whole lookup. Not thread safe, the store must outlive its
+ * lookups.
+ */
+template<typename Config = DefaultConfig>
+class BasicLookupStore
+{
+public:
+	using Updater = BasicWeightUpdater<Config>;
+	using Index = typename Config::Index;
+	using RealId = typename Config::RealId;
+	using Weight = typename Config::Weight;
+
+	struct Usage
+	{
+		std::size_t tables;
+		std::size_t bytes;
+		// bytes the lookups would take without sharing
+		std::size_t referenced_bytes;
+	};
+
+private:
+	/* @brief Input of MakeWeightUpdater kept to tell it from another one
+	 * with the same fingerprint. Reals are of the type the table was
+	 * acquired with, \same compares them.
+	 */
+	struct Input
+	{
+		std::shared_ptr<const void> reals;
+		bool (*same)(const void* stored, const void* reals, Index cnt);
+		std::vector<RealId> ids;
+		std::vector<Weight> weights;
+		Index side_rings_count;
+		Index segments_per_weight;
+		Index lookup_size;
+	};
+
+	struct Table
+	{
+		std::vector<RealId> cells;
+		std::uint64_t hash;
+		// fingerprint of updater input, 0 once the table was updated
+		std::uint64_t input;
+		// empty once the table was updated
+		Input source{};
+	};
+
+	std::unordered_multimap<std::uint64_t, std::weak_ptr<Table>> by_content_;
+	std::unordered_map<std::uint64_t, std::weak_ptr<Table>> by_input_;
+	std::pmr::vector<typename Updater::Slice> changes_;
+
+public:
+	/* @brief Handle of a stored lookup, copies share the table.
+	 */
+	class Lookup
+	{
+		friend class BasicLookupStore;
+		std::shared_ptr<Table> table_;
+
+	public:
+		const RealId* Data() const
+		{
+			return table_->cells.data();
+		}
+
+		Index Size() const
+		{
+			return table_->cells.size();
+		}
+
+		bool Shared() const
+		{
+			return table_.use_count() > 1;
+		}
+
+		std::uint64_t ContentHash() const
+		{
+			return table_->hash;
+		}
+	};
+
+	static std::uint64_t Mix(std::size_t index, RealId id)
+	{
+		std::uint64_t z = (std::uint64_t{index} << 32 ^ id) + 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	static std::uint64_t ContentHash(const RealId* cells, std::size_t size)
+	{
+		std::uint64_t hash{};
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			hash += Mix(i, cells[i]);
+		}
+		return hash;
+	}
+
+	/* @brief Fingerprint of everything the lookup built by MakeWeightUpdater
+	 * depends on.
+	 */
+	template<typename Real>
+	static std::uint64_t InputFingerprint(const Real* reals,
+	                                      const RealId* ids,
+	                                      const Weight* weights,
+	                                      Index cnt,
+	                                      Index side_rings_count,
+	                                      Index segments_per_weight,
+	                                      Index lookup_size)
+	{
+		IdHash h = CalcHash(lookup_size, CalcHash(segments_per_weight, CalcHash(side_rings_count, 0)));
+		IdHash g = CalcHash(Config::RNG_SEED, h);
+		for (Index i = 0; i < cnt; ++i)
+		{
+			h = CalcHash(reals[i], h);
+			g = CalcHash(weights[i], CalcHash(ids[i], g));
+		}
+		// 0 marks updated tables
+		return std::max<std::uint64_t>((std::uint64_t{h} << 32) | g, 1);
+	}
+
+	/* @brief Returns lookup of \updater built by MakeWeightUpdater from the
+	 * rest of arguments, \input is their InputFingerprint. A table stored
+	 * for the same input or with the same contents is shared, fingerprints
+	 * alone are not trusted.
+	 */
+	template<typename Real>
+	Lookup Acquire(const Updater& updater,
+	               std::uint64_t input,
+	               const Real* reals,
+	               const RealId* ids,
+	               const Weight* weights,
+	               Index cnt,
+	               Index side_rings_count,
+	               Index segments_per_weight)
+	{
+		Lookup lookup;
+		if (auto it = by_input_.find(input); it != by_input_.end())
+		{
+			lookup.table_ = it->second.lock();
+			if (lookup.table_ &&
+			    Same(lookup.table_->source,
+			         reals,
+			         ids,
+			         weights,
+			         cnt,
+			         side_rings_count,
+			         segments_per_weight,
+			         updater.LookupSize()))
+			{
+				return lookup;
+			}
+			if (!lookup.table_)
+			{
+				by_input_.erase(it);
+			}
+		}
+
+		auto table = std::make_shared<Table>();
+		table->cells.resize(updater.LookupSize());
+		updater.InitLookup(table->cells.data());
+		table->hash = ContentHash(table->cells.data(), table->cells.size());
+		table->input = input;
+		table->source = Input{std::make_shared<const std::vector<Real>>(reals, reals + cnt),
+		                      &SameReals<Real>,
+		                      std::vector<RealId>(ids, ids + cnt),
+		                      std::vector<Weight>(weights, weights + cnt),
+		                      side_rings_count,
+		                      segments_per_weight,
+		                      updater.LookupSize()};
+		lookup.table_ = Intern(std::move(table));
+		if (lookup.table_->input == input)
+		{
+			by_input_[input] = lookup.table_;
+		}
+		return lookup;
+	}
+
+	/* @brief Same as Updater::UpdateLookup on \lookup. A shared table is
+	 * copied before the first change, the result is shared with an equal
+	 * stored table if there is one.
+	 */
+	void Update(Lookup& lookup, Updater& updater, const RealId* ids, const Weight* weights, Index count)
+	{
+		auto& table = lookup.table_;
+		if (table.use_count() > 1)
+		{
+			table = std::make_shared<Table>(Table{table->cells, table->hash, 0});
+		}
+		else
+		{
+			Forget(table);
+			table->input = 0;
+			table->source = Input{};
+		}
+
+		changes_.clear();
+		updater.UpdateLookup(ids, weights, count, table->cells.data(), changes_);
+		for (const auto& slice : changes_)
+		{
+			for (Index i = slice.start; i < slice.start + slice.count; ++i)
+			{
+				table->hash += Mix(i, slice.id) - Mix(i, slice.was);
+			}
+		}
+		table = Intern(std::move(table));
+	}
+
+	Usage Statistics()
+	{
+		Usage usage{};
+		for (auto it = by_content_.begin(); it != by_content_.end();)
+		{
+			auto table = it->second.lock();
+			if (!table)
+			{
+				it = by_content_.erase(it);
+				continue;
+			}
+			++usage.tables;
+			usage.bytes += table->cells.size() * sizeof(RealId);
+			// one reference is ours
+			usage.referenced_bytes += (table.use_count() - 1) * table->cells.size() * sizeof(RealId);
+			++it;
+		}
+		return usage;
+	}
+
+private:
+	template<typename Real>
+	static bool SameReals(const void* stored, const void* reals, Index cnt)
+	{
+		const auto& kept = *static_cast<const std::vector<Real>*>(stored);
+		return kept.size() == cnt && std::equal(kept.begin(), kept.end(), static_cast<const Real*>(reals));
+	}
+
+	template<typename Real>
+	static bool Same(const Input& source,
+	                 const Real* reals,
+	                 const RealId* ids,
+	                 const Weight* weights,
+	                 Index cnt,
+	                 Index side_rings_count,
+	                 Index segments_per_weight,
+	                 Index lookup_size)
+	{
+		return source.same == &SameReals<Real> &&
+		       source.side_rings_count == side_rings_count &&
+		       source.segments_per_weight == segments_per_weight &&
+		       source.lookup_size == lookup_size &&
+		       std::equal(source.ids.begin(), source.ids.end(), ids, ids + cnt) &&
+		       std::equal(source.weights.begin(), source.weights.end(), weights, weights + cnt) &&
+		       source.same(source.reals.get(), reals, cnt);
+	}
+
+	std::shared_ptr<Table> Intern(std::shared_ptr<Table> table)
+	{
+		auto [first, last] = by_content_.equal_range(table->hash);
+		for (auto it = first; it != last;)
+		{
+			auto stored = it->second.lock();
+			if (!stored)
+			{
+				it = by_content_.erase(it);
+				continue;
+			}
+			if (stored != table && stored->cells == table->cells)
+			{
+				return stored;
+			}
+			++it;
+		}
+		by_content_.emplace(table->hash, table);
+		return table;
+	}
+
+	void Forget(const std::shared_ptr<Table>& table)
+	{
+		auto [first, last] = by_content_.equal_range(table->hash);
+		for (auto it = first; it != last; ++it)
+		{
+			if (it->second.lock() == table)
+			{
+				by_content_.erase(it);
+				break;
+			}
+		}
+		if (table->input != 0)
+		{
+			by_input_.erase(table->input);
+		}
+	}
+};
+
+using LookupStore = BasicLookupStore<DefaultConfig>;
+
+} // namespace chash
@@ -1,3 +1,4 @@
+#include <memory_resource>
 #include <optional>
 #include <vector>
 
@@ -11,6 +12,31 @@ using Weight = chash::DefaultConfig::Weight;
 constexpr std::size_t DFLT_MAPPINGS = 100;
 constexpr std::size_t DFLT_CELLS = 20;
 
+using chash::CountingResource;
+
+/* @brief Makes \resource the default pmr resource while alive, so that
+ * allocations the library makes past the resource it was given are
+ * counted there.
+ */
+class DefaultResource
+{
+	std::pmr::memory_resource* previous_;
+
+public:
+	explicit DefaultResource(std::pmr::memory_resource* resource) :
+	        previous_{std::pmr::set_default_resource(resource)}
+	{
+	}
+
+	DefaultResource(const DefaultResource&) = delete;
+	DefaultResource& operator=(const DefaultResource&) = delete;
+
+	~DefaultResource()
+	{
+		std::pmr::set_default_resource(previous_);
+	}
+};
+
 struct UpdaterInput
 {
 	std::vector<std::string> reals = {"alpha", "beta", "gamma", "delta"};
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+#include "common.h"
+
+#include "../analytics.hpp"
+
+namespace
+{
+
+using namespace test;
+
+// runs of random length and owner, as in a lookup with few heads per real
+std::vector<std::uint32_t> Clumpy(std::size_t size, std::uint32_t ids, std::size_t max_run, std::uint32_t seed)
+{
+	std::mt19937 gen(seed);
+	std::vector<std::uint32_t> lookup;
+	while (lookup.size() < size)
+	{
+		std::uint32_t id = gen() % ids;
+		std::size_t run = std::min<std::size_t>(1 + gen() % max_run, size - lookup.size());
+		lookup.insert(lookup.end(), run, id);
+	}
+	return lookup;
+}
+
+std::vector<std::pair<std::uint32_t, std::size_t>> ExpectedCounts(const std::vector<std::uint32_t>& lookup)
+{
+	std::map<std::uint32_t, std::size_t> counts;
+	for (auto id : lookup)
+	{
+		++counts[id];
+	}
+	return {counts.begin(), counts.end()};
+}
+
+std::vector<std::tuple<std::uint32_t, std::size_t, std::size_t>> ExpectedClumps(const std::vector<std::uint32_t>& lookup)
+{
+	std::map<std::pair<std::uint32_t, std::size_t>, std::size_t> m;
+	std::size_t start = 1;
+	while (start < lookup.size() && lookup[start] == lookup[start - 1])
+	{
+		++start;
+	}
+	if (start == lookup.size())
+	{
+		return {{lookup[0], lookup.size(), 1}};
+	}
+	std::uint32_t id = lookup[start];
+	std::size_t l{};
+	for (std::size_t i = 0; i < lookup.size(); ++i)
+	{
+		auto curr = lookup[(start + i) % lookup.size()];
+		if (id == curr)
+		{
+			++l;
+		}
+		else
+		{
+			++m[{id, l}];
+			id = curr;
+			l = 1;
+		}
+	}
+	++m[{id, l}];
+	std::vector<std::tuple<std::uint32_t, std::size_t, std::size_t>> result;
+	for (const auto& [run, count] : m)
+	{
+		result.emplace_back(run.first, run.second, count);
+	}
+	return result;
+}
+
+std::vector<std::tuple<std::uint32_t, std::size_t, std::size_t>> Flatten(const std::vector<chash::Clump>& clumps)
+{
+	std::vector<std::tuple<std::uint32_t, std::size_t, std::size_t>> result;
+	for (const auto& c : clumps)
+	{
+		result.emplace_back(c.id, c.length, c.count);
+	}
+	return result;
+}
+
+TEST(Analytics, MatchesScalar)
+{
+	for (std::size_t size : {1, 7, 8, 9, 1000, 300001})
+	{
+		for (std::uint32_t ids : {1u, 5u, 3000000u})
+		{
+			auto a = Clumpy(size, ids, 40, size + ids);
+			auto b = a;
+			std::mt19937 gen(ids);
+			for (std::size_t i = 0; i < size / 10; ++i)
+			{
+				b[gen() % size] = gen() % ids;
+			}
+
+			std::size_t mismatch{};
+			std::map<std::uint32_t, std::size_t> moved;
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				if (a[i] != b[i])
+				{
+					++mismatch;
+					++moved[b[i]];
+				}
+			}
+			auto counts = ExpectedCounts(a);
+			auto clumps = ExpectedClumps(a);
+
+			for (std::size_t threads : {1, 4})
+			{
+				ASSERT_EQ(chash::CountMismatches(a.data(), b.data(), size, threads), mismatch);
+				ASSERT_EQ(chash::MovedCells(a.data(), b.data(), size, threads),
+				          (std::vector<std::pair<std::uint32_t, std::size_t>>{moved.begin(), moved.end()}));
+				ASSERT_EQ(chash::CellCounts(a.data(), size, threads), counts);
+				ASSERT_EQ(Flatten(chash::Clumps(a.data(), size, threads)), clumps);
+			}
+		}
+	}
+}
+
+TEST(Analytics, RunsAcrossChunks)
+{
+	// one run spanning every chunk and wrapping around the end
+	std::vector<std::uint32_t> lookup(1 << 18, 7);
+	lookup[100] = 3;
+	lookup[200000] = chash::WeightUpdater::Invalid();
+	auto clumps = Flatten(chash::Clumps(lookup.data(), lookup.size(), 4));
+	ASSERT_EQ(clumps, ExpectedClumps(lookup));
+	ASSERT_EQ(chash::CellCounts(lookup.data(), lookup.size(), 4), ExpectedCounts(lookup));
+
+	std::fill(lookup.begin(), lookup.end(), 7);
+	clumps = Flatten(chash::Clumps(lookup.data(), lookup.size(), 4));
+	ASSERT_EQ(clumps, ExpectedClumps(lookup));
+}
+
+TEST(Analytics, UpdaterLookup)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto updater = MakeUpdater(input);
+	std::vector<RealId> before(input.lookup_size);
+	updater->InitLookup(before.data());
+	auto after = before;
+	std::vector<Weight> weights = {0, 100, 30, 7};
+	updater->UpdateLookup(input.ids.data(), weights.data(), weights.size(), after.data());
+
+	auto counts = chash::CellCounts(after.data(), after.size());
+	ASSERT_EQ(counts, ExpectedCounts(after));
+	auto moved = chash::MovedCells(before.data(), after.data(), after.size());
+	std::size_t total{};
+	for (const auto& [id, cells] : moved)
+	{
+		ASSERT_NE(id, 1);
+		total += cells;
+	}
+	ASSERT_EQ(total, chash::CountMismatches(before.data(), after.data(), after.size()));
+}
+
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+#include "common.h"
+
+#include "../chash.hpp"
+
+namespace
+{
+
+using namespace test;
+
+void ExpectBalance(const chash::WeightUpdater& updater,
+                   const std::vector<RealId>& ids,
+                   const std::vector<Weight>& weights,
+                   const std::vector<RealId>& lookup)
+{
+	std::map<RealId, std::size_t> cells;
+	for (auto id : lookup)
+	{
+		++cells[id];
+	}
+	std::size_t total = std::accumulate(weights.begin(), weights.end(), std::size_t{});
+	double error{};
+	for (std::size_t i = 0; i < ids.size(); ++i)
+	{
+		ASSERT_DOUBLE_EQ(updater.EffectiveShare(ids[i]), double(cells[ids[i]]) / lookup.size());
+		if (weights[i] != 0)
+		{
+			double requested = double(weights[i]) / total;
+			error = std::max(error, std::abs(double(cells[ids[i]]) / lookup.size() - requested) / requested);
+		}
+	}
+	ASSERT_NEAR(updater.MaxWeightError(), error, 1e-9);
+}
+
+TEST(Balance, FollowsUpdates)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto updater = MakeUpdater(input);
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+	updater->TrackBalance(lookup.data());
+	ExpectBalance(*updater, input.ids, input.weights, lookup);
+
+	std::mt19937 gen(7);
+	std::vector<Weight> weights = input.weights;
+	for (int step = 0; step < 200; ++step)
+	{
+		std::size_t i = gen() % weights.size();
+		// every fifth step drains a real, sometimes all of them
+		weights[i] = step % 5 == 0 ? 0 : gen() % 101;
+		if (step % 50 == 49)
+		{
+			std::fill(weights.begin(), weights.end(), 0);
+			updater->UpdateLookup(input.ids.data(), weights.data(), weights.size(), lookup.data());
+			ASSERT_EQ(updater->MaxWeightError(), 0);
+			ASSERT_EQ(updater->EffectiveShare(input.ids[0]), 0);
+			weights[i] = 10;
+		}
+		if (step % 2 == 0)
+		{
+			updater->UpdateWeight(input.ids[i], weights[i], lookup.data());
+		}
+		else
+		{
+			updater->UpdateLookup(input.ids.data(), weights.data(), weights.size(), lookup.data());
+		}
+		ExpectBalance(*updater, input.ids, weights, lookup);
+	}
+
+	std::vector<RealId> fresh(input.lookup_size);
+	updater->InitLookup(fresh.data());
+	ExpectBalance(*updater, input.ids, weights, fresh);
+}
+
+TEST(Balance, OnlyWhileTracking)
+{
+	UpdaterInput input;
+	auto updater = MakeUpdater(input);
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+	ASSERT_EQ(updater->EffectiveShare(1), 0);
+	ASSERT_EQ(updater->MaxWeightError(), 0);
+
+	updater->TrackBalance(lookup.data());
+	ASSERT_EQ(updater->EffectiveShare(42), 0);
+	ASSERT_NEAR(updater->EffectiveShare(1) + updater->EffectiveShare(2) + updater->EffectiveShare(3) +
+	                    updater->EffectiveShare(4),
+	            1,
+	            1e-12);
+
+	updater->StopBalance();
+	updater->UpdateWeight(1, 0, lookup.data());
+	ASSERT_EQ(updater->EffectiveShare(2), 0);
+}
+
+}
@@ -347,4 +347,25 @@ TEST(Balancer, onedown)
 	}
 }
 
+TEST(Balancer, SetWeightsMatchesUpdateWeight)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	std::vector<Weight> weights{30, 20, 0, 1};
+	auto batched = MakeUpdater(input);
+	auto single = MakeUpdater(input);
+	ASSERT_TRUE(batched && single);
+
+	std::vector<RealId> expected(input.lookup_size);
+	single->InitLookup(expected.data());
+	for (std::size_t i = 0; i < weights.size(); ++i)
+	{
+		single->UpdateWeight(input.ids[i], weights[i], expected.data());
+	}
+
+	std::vector<RealId> lookup(input.lookup_size);
+	batched->SetWeights(input.ids.data(), weights.data(), weights.size());
+	batched->InitLookup(lookup.data());
+	ASSERT_EQ(lookup, expected);
+}
+
 }
\ No newline at end of file
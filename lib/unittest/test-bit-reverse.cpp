@@ -4,6 +4,7 @@
 #include <gtest/gtest.h>
 
 #include "../bit-reverse.hpp"
+#include "../positions.hpp"
 
 namespace
 {
@@ -23,4 +24,70 @@ TEST(BitReverse, VisitsAll)
 	ASSERT_EQ(std::find(seen.begin(), seen.end(), false), seen.end());
 }
 
+TEST(BitReverse, PositionsSkipInvalid)
+{
+	for (std::uint32_t size : {1u, 2u, 100u, 777u, 1024u, 8000u, 65553u})
+	{
+		std::uint8_t bits = chash::PowerOfTwoLowerBound(size);
+		std::vector<std::uint32_t> expected;
+		for (std::uint32_t i = 0; expected.size() < 3 * size; ++i)
+		{
+			std::uint32_t pos = bits == 0 ? 0 : ReverseBits(bits, i % (1u << bits));
+			if (pos < size)
+			{
+				expected.push_back(pos);
+			}
+		}
+
+		for (std::size_t batch : {1u, 255u, 256u, 1000u})
+		{
+			chash::BitReversedPositions positions(size);
+			std::vector<std::uint32_t> got(expected.size() + batch);
+			for (std::size_t n = 0; n < expected.size(); n += batch)
+			{
+				positions.Next(got.data() + n, batch);
+			}
+			got.resize(expected.size());
+			ASSERT_EQ(got, expected) << "size: " << size << " batch: " << batch;
+		}
+	}
+}
+
+TEST(BitReverse, PositionsFromIndex)
+{
+	const std::uint32_t size = 5000;
+	chash::BitReversedPositions whole(size);
+	std::vector<std::uint32_t> expected(size);
+	whole.Next(expected.data(), size);
+
+	chash::BitReversedPositions tail(size, 300);
+	std::vector<std::uint32_t> got(size - 300 / 2);
+	tail.Next(got.data(), got.size());
+	auto first = std::find(expected.begin(), expected.end(), ReverseBits(13, 300));
+	ASSERT_TRUE(std::equal(got.begin(), got.begin() + 100, first));
+}
+
+
+TEST(BitReverse, PositionsOfIndexRanges)
+{
+	for (std::uint32_t size : {1u, 777u, 8000u, 65553u})
+	{
+		chash::BitReversedPositions whole(size);
+		std::vector<std::uint32_t> expected(2 * size);
+		whole.Next(expected.data(), expected.size());
+
+		// uneven ranges, some of them aligned to blocks
+		chash::BitReversedPositions positions(size);
+		std::vector<std::uint32_t> got;
+		for (std::uint64_t count : {1u, 255u, 256u, 512u, 3000u, 70000u})
+		{
+			std::vector<std::uint32_t> range(count);
+			range.resize(positions.Take(range.data(), count));
+			got.insert(got.end(), range.begin(), range.end());
+		}
+		got.resize(std::min(got.size(), expected.size()));
+		ASSERT_TRUE(std::equal(got.begin(), got.end(), expected.begin())) << "size: " << size;
+	}
+}
+
 }
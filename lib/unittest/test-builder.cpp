@@ -0,0 +1,135 @@
+#include <memory_resource>
+
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../builder.hpp"
+
+namespace
+{
+
+using namespace test;
+
+std::vector<UpdaterInput> Services()
+{
+	std::vector<UpdaterInput> result;
+	result.push_back(UpdaterInput{.weights = {100, 20, 50, 1}});
+	UpdaterInput big{};
+	for (std::size_t i = 0; i < 30; ++i)
+	{
+		big.reals.push_back("real" + std::to_string(i));
+		big.ids.push_back(100 + i);
+		big.weights.push_back(1 + i * 3);
+	}
+	big.lookup_size = chash::WeightUpdater::LookupRequiredSize(big.ids.size(), big.cells);
+	result.push_back(big);
+	result.push_back(UpdaterInput{.reals = {"x", "y"}, .ids = {7, 7}, .weights = {10, 0}});
+	return result;
+}
+
+TEST(Builder, MatchesMakeWeightUpdater)
+{
+	chash::UpdaterBuilder builder;
+	for (int round = 0; round < 2; ++round)
+	{
+		for (auto& input : Services())
+		{
+			auto expected = MakeUpdater(input);
+			auto built = builder.MakeWeightUpdater(input.reals.data(),
+			                                       input.ids.data(),
+			                                       input.weights.data(),
+			                                       input.ids.size(),
+			                                       input.mappings,
+			                                       input.cells,
+			                                       input.lookup_size);
+			ASSERT_EQ(expected.has_value(), built.has_value());
+			if (!expected)
+			{
+				continue;
+			}
+			std::vector<RealId> lookup(input.lookup_size);
+			std::vector<RealId> expected_lookup(input.lookup_size);
+			built->InitLookup(lookup.data());
+			expected->InitLookup(expected_lookup.data());
+			ASSERT_EQ(lookup, expected_lookup);
+		}
+	}
+}
+
+TEST(Builder, SteadyStateDoesNotAllocateScratch)
+{
+	auto services = Services();
+	CountingResource scratch;
+	CountingResource result;
+	chash::UpdaterBuilder builder(&scratch);
+
+	auto build = [&] {
+		for (auto& input : services)
+		{
+			std::pmr::monotonic_buffer_resource arena(&result);
+			auto updater = builder.MakeWeightUpdater(input.reals.data(),
+			                                         input.ids.data(),
+			                                         input.weights.data(),
+			                                         input.ids.size(),
+			                                         input.mappings,
+			                                         input.cells,
+			                                         input.lookup_size,
+			                                         &arena);
+			ASSERT_TRUE(updater);
+		}
+	};
+
+	build();
+	ASSERT_GT(scratch.allocations.load(), 0);
+	std::size_t warm = scratch.allocations;
+	CountingResource stray;
+	{
+		DefaultResource scope(&stray);
+		build();
+	}
+	ASSERT_EQ(scratch.allocations.load(), warm);
+	ASSERT_EQ(stray.allocations.load(), 0);
+
+	builder.Release();
+	build();
+	ASSERT_GT(scratch.allocations.load(), warm);
+}
+
+TEST(Builder, RingCacheReusesRings)
+{
+	UpdaterInput first{.weights = {100, 20, 50, 1}};
+	UpdaterInput second{.weights = {1, 2, 3, 4}};
+	UpdaterInput other{.reals = {"one", "two", "three"}, .ids = {1, 2, 3}, .weights = {5, 5, 5}};
+	other.lookup_size = chash::WeightUpdater::LookupRequiredSize(other.ids.size(), other.cells);
+
+	chash::UpdaterBuilder builder;
+	// room for rings of one real set
+	chash::BasicRingCache<std::string> cache(DFLT_MAPPINGS);
+	for (auto* input : {&first, &second, &first, &other, &first})
+	{
+		auto built = builder.MakeWeightUpdater(input->reals.data(),
+		                                       input->ids.data(),
+		                                       input->weights.data(),
+		                                       input->ids.size(),
+		                                       input->mappings,
+		                                       input->cells,
+		                                       input->lookup_size,
+		                                       std::pmr::get_default_resource(),
+		                                       &cache);
+		ASSERT_TRUE(built);
+		std::vector<RealId> lookup(input->lookup_size);
+		std::vector<RealId> expected(input->lookup_size);
+		built->InitLookup(lookup.data());
+		MakeUpdater(*input)->InitLookup(expected.data());
+		ASSERT_EQ(lookup, expected);
+	}
+
+	auto stats = cache.Statistics();
+	ASSERT_EQ(stats.hits, 2);
+	ASSERT_EQ(stats.misses, 3);
+	ASSERT_EQ(stats.evictions, 2);
+	ASSERT_EQ(cache.Rings(), DFLT_MAPPINGS);
+}
+
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+#include "common.h"
+
+#include "../chash.hpp"
+
+namespace
+{
+
+using namespace test;
+
+using Cells = std::vector<std::pair<RealId, std::size_t>>;
+
+void ExpectEstimate(chash::WeightUpdater& updater,
+                    const std::vector<RealId>& ids,
+                    const std::vector<Weight>& weights,
+                    std::vector<RealId>& lookup)
+{
+	auto estimate = updater.EstimateDisruption(ids.data(), weights.data(), ids.size(), lookup.data());
+	std::vector<RealId> before = lookup;
+	updater.UpdateLookup(ids.data(), weights.data(), ids.size(), lookup.data());
+
+	std::map<RealId, std::size_t> donors;
+	std::map<RealId, std::size_t> receivers;
+	std::size_t moved{};
+	for (std::size_t i = 0; i < lookup.size(); ++i)
+	{
+		if (before[i] != lookup[i])
+		{
+			++moved;
+			++donors[before[i]];
+			++receivers[lookup[i]];
+		}
+	}
+	ASSERT_EQ(estimate.moved, moved);
+	ASSERT_EQ(estimate.donors, Cells(donors.begin(), donors.end()));
+	ASSERT_EQ(estimate.receivers, Cells(receivers.begin(), receivers.end()));
+
+	// the estimate relies on lookups depending on enabled heads alone
+	std::vector<RealId> fresh(lookup.size());
+	updater.InitLookup(fresh.data());
+	ASSERT_EQ(fresh, lookup);
+}
+
+void ExpectEstimates(std::size_t lookup_size)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	input.lookup_size = lookup_size;
+	auto updater = MakeUpdater(input);
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+
+	std::mt19937 gen(11);
+	for (int step = 0; step < 300; ++step)
+	{
+		std::vector<RealId> ids;
+		std::vector<Weight> weights;
+		for (std::size_t n = gen() % 4 + 1; n != 0; --n)
+		{
+			// unknown reals and repeated ones included
+			ids.push_back(gen() % 6 + 1);
+			weights.push_back(step % 7 == 0 ? 0 : gen() % 101);
+		}
+		if (step % 60 == 59)
+		{
+			ids = input.ids;
+			weights.assign(ids.size(), 0);
+		}
+		ExpectEstimate(*updater, ids, weights, lookup);
+	}
+}
+
+TEST(Disruption, MatchesUpdates)
+{
+	ExpectEstimates(UpdaterInput{}.lookup_size);
+}
+
+// the last cell is an enabled head while cell 0 is not in some steps,
+// InitLookup must take the tint of the first cells from it
+TEST(Disruption, MatchesUpdatesOddSize)
+{
+	ExpectEstimates(8191);
+}
+
+TEST(Disruption, NoChange)
+{
+	UpdaterInput input;
+	auto updater = MakeUpdater(input);
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+	auto estimate = updater->EstimateDisruption(input.ids.data(), input.weights.data(), input.ids.size(), lookup.data());
+	ASSERT_EQ(estimate.moved, 0);
+	ASSERT_TRUE(estimate.donors.empty());
+	ASSERT_TRUE(estimate.receivers.empty());
+}
+
+} // namespace
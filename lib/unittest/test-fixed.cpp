@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../fixed.hpp"
+
+namespace
+{
+
+using namespace test;
+
+template<std::size_t Size>
+void CompareWithDynamic()
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	input.lookup_size = Size;
+
+	auto dynamic = MakeUpdater(input);
+	ASSERT_TRUE(dynamic);
+	std::vector<RealId> lookup(Size);
+	dynamic->InitLookup(lookup.data());
+
+	auto fixed = chash::BasicFixedWeightUpdater<Size>::MakeWeightUpdater(input.reals.data(),
+	                                                                     input.ids.data(),
+	                                                                     input.weights.data(),
+	                                                                     input.ids.size(),
+	                                                                     input.mappings,
+	                                                                     input.cells);
+	ASSERT_TRUE(fixed);
+	ASSERT_TRUE(std::equal(lookup.begin(), lookup.end(), fixed->Lookup()));
+
+	std::vector<std::pair<RealId, Weight>> changes = {{1, 0}, {3, 100}, {4, 70}, {2, 0}, {1, 5}, {3, 0}, {4, 0}, {1, 0}, {2, 100}};
+	for (auto [id, weight] : changes)
+	{
+		dynamic->UpdateWeight(id, weight, lookup.data());
+		fixed->UpdateWeight(id, weight);
+		ASSERT_TRUE(std::equal(lookup.begin(), lookup.end(), fixed->Lookup())) << "id: " << id;
+	}
+	ASSERT_EQ(fixed->Select(Size + 1), lookup[1]);
+}
+
+TEST(Fixed, MatchesDynamic)
+{
+	CompareWithDynamic<8000>();
+}
+
+TEST(Fixed, MatchesDynamicPowerOfTwo)
+{
+	CompareWithDynamic<8192>();
+}
+
+TEST(Fixed, WrongSize)
+{
+	UpdaterInput input{};
+	auto dynamic = MakeUpdater(input);
+	ASSERT_TRUE(dynamic);
+	ASSERT_FALSE(chash::BasicFixedWeightUpdater<8192>::From(std::move(dynamic.value())));
+}
+
+
+struct Calls : chash::BasicRecorder<chash::DefaultConfig>
+{
+	std::vector<std::pair<chash::Operation, std::vector<RealId>>> calls;
+
+	void Record(std::uint32_t /* service */,
+	            chash::Operation op,
+	            const RealId* ids,
+	            const Weight* /* weights */,
+	            chash::DefaultConfig::Index count) override
+	{
+		calls.emplace_back(op, std::vector<RealId>(ids, ids + count));
+	}
+};
+
+TEST(Fixed, UpdatesGoThroughHooks)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto dynamic = MakeUpdater(input);
+	ASSERT_TRUE(dynamic);
+	std::vector<RealId> lookup(input.lookup_size);
+	dynamic->InitLookup(lookup.data());
+	dynamic->TrackBalance(lookup.data());
+	auto fixed = chash::BasicFixedWeightUpdater<8000>::From(std::move(MakeUpdater(input).value()));
+	ASSERT_TRUE(fixed);
+	fixed->TrackBalance();
+
+	Calls calls;
+	fixed->SetRecorder(&calls);
+	std::vector<Weight> weights = {0, 100, 30, 7};
+	fixed->UpdateWeight(2, 0);
+	fixed->UpdateLookup(input.ids.data(), weights.data(), weights.size());
+	dynamic->UpdateWeight(2, 0, lookup.data());
+	dynamic->UpdateLookup(input.ids.data(), weights.data(), weights.size(), lookup.data());
+
+	ASSERT_EQ(calls.calls.size(), 2);
+	ASSERT_EQ(calls.calls[0].first, chash::Operation::UPDATE_WEIGHT);
+	ASSERT_EQ(calls.calls[0].second, std::vector<RealId>{2});
+	ASSERT_EQ(calls.calls[1].first, chash::Operation::UPDATE_LOOKUP);
+	ASSERT_EQ(calls.calls[1].second, input.ids);
+	ASSERT_EQ(fixed->MaxWeightError(), dynamic->MaxWeightError());
+	for (auto id : input.ids)
+	{
+		ASSERT_EQ(fixed->EffectiveShare(id), dynamic->EffectiveShare(id)) << "id: " << id;
+	}
+}
+
+}
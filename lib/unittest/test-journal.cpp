@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../journal.hpp"
+
+namespace
+{
+
+using namespace test;
+
+TEST(Journal, RecordsEveryCall)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto updater = MakeUpdater(input);
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+
+	chash::JournalWriter writer;
+	writer.Declare(7, input.ids.data(), input.weights.data(), input.ids.size());
+	updater->SetRecorder(&writer, 7);
+
+	std::vector<Weight> weights = {0, 100, 30, 7};
+	updater->UpdateWeight(2, 0, lookup.data());
+	updater->UpdateLookup(input.ids.data(), weights.data(), weights.size(), lookup.data());
+	std::pmr::vector<chash::WeightUpdater::Slice> changes;
+	updater->UpdateLookup(input.ids.data(), input.weights.data(), input.ids.size(), lookup.data(), changes);
+	updater->SetWeights(input.ids.data(), weights.data(), weights.size());
+	updater->SetRecorder(nullptr);
+	updater->UpdateWeight(1, 1, lookup.data());
+	ASSERT_EQ(writer.Events(), 4 + 1 + 4 + 4 + 4);
+
+	auto data = writer.Data();
+	auto reader = chash::JournalReader::Open(data.data(), data.size());
+	ASSERT_TRUE(reader);
+	std::vector<chash::Operation> ops;
+	std::uint64_t timestamp{};
+	while (auto record = reader->Next())
+	{
+		ASSERT_EQ(record->service, 7);
+		ASSERT_GE(record->timestamp, timestamp);
+		timestamp = record->timestamp;
+		ops.push_back(record->op);
+		if (record->op == chash::Operation::UPDATE_WEIGHT)
+		{
+			ASSERT_EQ(record->ids, std::vector<RealId>{2});
+			ASSERT_EQ(record->weights, std::vector<Weight>{0});
+		}
+		if (record->op == chash::Operation::SET_WEIGHTS)
+		{
+			ASSERT_EQ(record->ids, input.ids);
+			ASSERT_EQ(record->weights, weights);
+		}
+	}
+	ASSERT_TRUE(reader->Complete());
+	std::vector<chash::Operation> expected = {chash::Operation::MAKE,
+	                                          chash::Operation::UPDATE_WEIGHT,
+	                                          chash::Operation::UPDATE_LOOKUP,
+	                                          chash::Operation::UPDATE_LOOKUP,
+	                                          chash::Operation::SET_WEIGHTS};
+	ASSERT_EQ(ops, expected);
+}
+
+TEST(Journal, ReplayReproducesLookup)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto recorded = MakeUpdater(input);
+	auto replayed = MakeUpdater(input);
+	std::vector<RealId> expected(input.lookup_size);
+	std::vector<RealId> lookup(input.lookup_size);
+	recorded->InitLookup(expected.data());
+	replayed->InitLookup(lookup.data());
+
+	chash::JournalWriter writer;
+	recorded->SetRecorder(&writer);
+	for (Weight w : {0, 3, 100, 0, 42})
+	{
+		recorded->UpdateWeight(3, w, expected.data());
+		std::vector<Weight> weights = {w, Weight(100 - w), 1, 50};
+		recorded->UpdateLookup(input.ids.data(), weights.data(), weights.size(), expected.data());
+	}
+
+	auto data = writer.Data();
+	auto reader = chash::JournalReader::Open(data.data(), data.size());
+	ASSERT_TRUE(reader);
+	while (auto record = reader->Next())
+	{
+		replayed->UpdateLookup(record->ids.data(), record->weights.data(), record->ids.size(), lookup.data());
+	}
+	ASSERT_EQ(lookup, expected);
+}
+
+TEST(Journal, RejectsDamaged)
+{
+	chash::JournalWriter writer;
+	std::vector<RealId> ids = {1, 200000};
+	std::vector<Weight> weights = {100, 1};
+	writer.Record(1, chash::Operation::UPDATE_LOOKUP, ids.data(), weights.data(), ids.size());
+	writer.Record(2, chash::Operation::UPDATE_LOOKUP, ids.data(), weights.data(), ids.size());
+	auto data = writer.Data();
+
+	auto truncated = chash::JournalReader::Open(data.data(), data.size() - 1);
+	ASSERT_TRUE(truncated);
+	ASSERT_TRUE(truncated->Next());
+	ASSERT_FALSE(truncated->Next());
+	ASSERT_FALSE(truncated->Complete());
+
+	ASSERT_FALSE(chash::JournalReader::Open(data.data(), sizeof(chash::JournalHeader) - 1));
+	data[0] = 'X';
+	ASSERT_FALSE(chash::JournalReader::Open(data.data(), data.size()));
+}
+
+}
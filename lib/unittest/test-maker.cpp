@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../chash.hpp"
+
+namespace
+{
+
+using namespace test;
+
+using Maker = chash::BasicUpdaterMaker<chash::DefaultConfig, std::string>;
+
+Maker MakeMaker(const UpdaterInput& input)
+{
+	return Maker(input.reals.data(),
+	             input.ids.data(),
+	             input.weights.data(),
+	             input.ids.size(),
+	             input.mappings,
+	             input.cells,
+	             input.lookup_size);
+}
+
+TEST(Maker, SteppedMatchesBlocking)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	input.lookup_size = input.lookup_size * 3 / 2;
+
+	auto blocking = MakeUpdater(input);
+	ASSERT_TRUE(blocking);
+	std::vector<RealId> expected(input.lookup_size);
+	blocking->InitLookup(expected.data());
+
+	for (std::size_t budget : {1, 7, 1000})
+	{
+		auto maker = MakeMaker(input);
+		std::size_t steps{};
+		while (!maker.Finished())
+		{
+			maker.Step(budget);
+			++steps;
+		}
+		ASSERT_EQ(maker.Current(), Maker::Phase::DONE);
+		ASSERT_GE(steps * budget, input.mappings + input.ids.size());
+
+		auto stepped = maker.Result();
+		ASSERT_TRUE(stepped);
+		std::vector<RealId> lookup(input.lookup_size);
+		stepped->InitLookup(lookup.data());
+		ASSERT_EQ(lookup, expected) << "budget: " << budget;
+	}
+}
+
+struct CounterConfig : chash::DefaultConfig
+{
+	using Rng = chash::CounterRng;
+};
+
+template<typename Maker>
+void ExpectSameForThreads(const UpdaterInput& input)
+{
+	std::vector<RealId> expected;
+	for (std::size_t threads : {1, 2, 3, 8})
+	{
+		for (std::size_t budget : {std::size_t{999}, std::numeric_limits<std::size_t>::max()})
+		{
+			Maker maker(input.reals.data(),
+			            input.ids.data(),
+			            input.weights.data(),
+			            input.ids.size(),
+			            input.mappings,
+			            input.cells,
+			            input.lookup_size);
+			maker.SetThreads(threads);
+			while (!maker.Finished())
+			{
+				maker.Step(budget);
+			}
+			auto updater = maker.Result();
+			ASSERT_TRUE(updater);
+
+			std::vector<RealId> lookup(input.lookup_size);
+			updater->InitLookup(lookup.data());
+			if (expected.empty())
+			{
+				expected = lookup;
+			}
+			ASSERT_EQ(lookup, expected) << "threads: " << threads;
+		}
+	}
+
+	std::map<RealId, std::size_t> dist;
+	for (auto e : expected)
+	{
+		++dist[e];
+	}
+	ASSERT_EQ(dist.size(), input.ids.size());
+}
+
+TEST(Maker, ThreadsDoNotChangeResult)
+{
+	using CounterMaker = chash::BasicUpdaterMaker<CounterConfig, std::string>;
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	// rounds between rebalances long enough to be split between threads
+	UpdaterInput wide{.reals = {}, .ids = {}, .weights = {}};
+	for (std::size_t i = 0; i < 50; ++i)
+	{
+		wide.reals.push_back("real" + std::to_string(i));
+		wide.ids.push_back(i + 1);
+		wide.weights.push_back(1 + i * 2);
+	}
+	wide.lookup_size = chash::WeightUpdater::LookupRequiredSize(wide.ids.size(), wide.cells) * 3 / 2;
+
+	ExpectSameForThreads<CounterMaker>(input);
+	ExpectSameForThreads<CounterMaker>(wide);
+}
+
+std::uint64_t LayoutHash(const std::vector<RealId>& lookup)
+{
+	// FNV-1a of cells
+	std::uint64_t hash = 14695981039346656037ull;
+	for (auto id : lookup)
+	{
+		hash = (hash ^ id) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// lookups built from the same input must not change between versions, nodes
+// of a fleet running different ones would map flows differently
+TEST(Maker, KeepsLayout)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	// 8191 cells: the last cell is a head, cell 0 is not
+	for (auto [size, expected] : {std::pair<std::size_t, std::uint64_t>{8000, 0xfb723f9969a522ee},
+	                              std::pair<std::size_t, std::uint64_t>{12000, 0x0b23e60d5cd6a7e1},
+	                              std::pair<std::size_t, std::uint64_t>{8191, 0xad8d015005f53298}})
+	{
+		input.lookup_size = size;
+		auto updater = MakeUpdater(input);
+		ASSERT_TRUE(updater);
+		std::vector<RealId> lookup(size);
+		updater->InitLookup(lookup.data());
+		ASSERT_EQ(LayoutHash(lookup), expected) << size;
+	}
+}
+
+// a second real enabled while one is active, its first slice covers cell 0;
+// versions before the EnableSlice fix built a different lookup here
+TEST(Maker, KeepsLayoutOfUpdates)
+{
+	UpdaterInput input{.weights = {0, 0, 49, 0}};
+	input.lookup_size = 8267;
+	auto updater = MakeUpdater(input);
+	ASSERT_TRUE(updater);
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+	ASSERT_EQ(LayoutHash(lookup), 0xc8790aab38d01dd8);
+	updater->UpdateWeight(1, 34, lookup.data());
+	ASSERT_EQ(LayoutHash(lookup), 0xa5349fd58a294c02);
+}
+
+TEST(Maker, InvalidInput)
+{
+	UpdaterInput input{};
+	input.mappings = 0;
+	auto maker = MakeMaker(input);
+	ASSERT_TRUE(maker.Finished());
+	ASSERT_EQ(maker.Step(1), Maker::Phase::FAILED);
+	ASSERT_FALSE(maker.Result());
+}
+
+}
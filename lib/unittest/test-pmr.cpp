@@ -0,0 +1,61 @@
+#include <memory_resource>
+
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../snapshot.hpp"
+
+namespace
+{
+
+using namespace test;
+
+TEST(Pmr, ConstructionUsesResourceOnly)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	std::vector<RealId> expected(input.lookup_size);
+	MakeUpdater(input)->InitLookup(expected.data());
+
+	CountingResource counting;
+	std::pmr::monotonic_buffer_resource arena(&counting);
+	CountingResource stray;
+	DefaultResource scope(&stray);
+	auto updater = chash::MakeWeightUpdater(input.reals.data(),
+	                                        input.ids.data(),
+	                                        input.weights.data(),
+	                                        input.ids.size(),
+	                                        input.mappings,
+	                                        input.cells,
+	                                        input.lookup_size,
+	                                        &arena);
+	ASSERT_TRUE(updater);
+	ASSERT_EQ(updater->Resource(), &arena);
+	ASSERT_GT(counting.allocations.load(), 0);
+	ASSERT_EQ(stray.allocations.load(), 0);
+
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+	ASSERT_EQ(lookup, expected);
+
+	auto moved = std::move(updater.value());
+	moved.UpdateLookup(input.ids.data(), input.weights.data(), input.ids.size(), lookup.data());
+	ASSERT_EQ(stray.allocations.load(), 0);
+	ASSERT_EQ(moved.Resource(), &arena);
+}
+
+TEST(Pmr, SnapshotLoadsIntoResource)
+{
+	UpdaterInput input{};
+	auto updater = MakeUpdater(input);
+	ASSERT_TRUE(updater);
+	auto image = chash::Snapshot::Serialize(updater.value());
+
+	CountingResource counting;
+	auto restored = chash::Snapshot::Load(image.data(), image.size(), &counting);
+	ASSERT_TRUE(restored);
+	ASSERT_EQ(restored->Resource(), &counting);
+	ASSERT_GE(counting.bytes.load(), input.lookup_size * sizeof(chash::WeightUpdater::Index));
+}
+
+}
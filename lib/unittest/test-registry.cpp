@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../registry.hpp"
+
+namespace
+{
+
+using namespace test;
+
+using Registry = chash::ServiceRegistry<std::string>;
+
+Registry::ServiceSpec Spec(const UpdaterInput& input)
+{
+	return Registry::ServiceSpec{input.reals.data(),
+	                             input.ids.data(),
+	                             input.weights.data(),
+	                             static_cast<chash::WeightUpdater::Index>(input.ids.size()),
+	                             static_cast<chash::WeightUpdater::Index>(input.mappings),
+	                             static_cast<chash::WeightUpdater::Index>(input.cells)};
+}
+
+std::vector<RealId> Expected(const UpdaterInput& input)
+{
+	std::vector<RealId> lookup(input.lookup_size);
+	MakeUpdater(input)->InitLookup(lookup.data());
+	return lookup;
+}
+
+TEST(Registry, BatchCreateUpdateDestroy)
+{
+	std::vector<UpdaterInput> inputs{UpdaterInput{},
+	                                 UpdaterInput{.weights = {100, 20, 50, 1}},
+	                                 UpdaterInput{.reals = {"a", "b"}, .ids = {5, 6}, .weights = {1, 2}, .lookup_size = 2 * 100 * DFLT_CELLS},
+	                                 UpdaterInput{.reals = {}, .ids = {}, .weights = {}}};
+	std::vector<Registry::ServiceSpec> specs;
+	for (auto& input : inputs)
+	{
+		specs.push_back(Spec(input));
+	}
+
+	// small slabs to have services spread over several of them
+	Registry registry(10000);
+	std::vector<std::optional<Registry::ServiceId>> ids(specs.size());
+	registry.CreateBatch(specs.data(), specs.size(), ids.data(), 2);
+	ASSERT_FALSE(ids[3]);
+	for (std::size_t i = 0; i < 3; ++i)
+	{
+		ASSERT_TRUE(ids[i]);
+		auto expected = Expected(inputs[i]);
+		ASSERT_TRUE(std::equal(expected.begin(), expected.end(), registry.Lookup(ids[i].value())));
+	}
+	auto usage = registry.Usage();
+	ASSERT_EQ(usage.services, 3);
+	ASSERT_EQ(usage.lookups, (8000 + 8000 + 4000) * sizeof(RealId));
+	ASSERT_GE(usage.slabs, usage.lookups);
+	ASSERT_EQ(usage.slabs % chash::LookupStorage::HUGE_PAGE, 0);
+	ASSERT_GT(usage.updaters, 0);
+
+	std::vector<Weight> weights{0, 50, 100, 3};
+	std::vector<Registry::ServiceUpdate> updates;
+	for (std::size_t i : {0, 1, 0})
+	{
+		updates.push_back({ids[i].value(), inputs[i].ids.data(), weights.data(), 4});
+	}
+	registry.UpdateBatch(updates.data(), updates.size(), 2);
+	for (std::size_t i : {0, 1})
+	{
+		auto updater = MakeUpdater(inputs[i]);
+		std::vector<RealId> expected(inputs[i].lookup_size);
+		updater->InitLookup(expected.data());
+		updater->UpdateLookup(inputs[i].ids.data(), weights.data(), 4, expected.data());
+		ASSERT_TRUE(std::equal(expected.begin(), expected.end(), registry.Lookup(ids[i].value())));
+	}
+
+	registry.Destroy(ids[0].value());
+	ASSERT_EQ(registry.Lookup(ids[0].value()), nullptr);
+	ASSERT_EQ(registry.Usage().lookups, (8000 + 4000) * sizeof(RealId));
+
+	// freed cells and id are reused
+	auto again = registry.Create(specs[0]);
+	ASSERT_EQ(again, ids[0]);
+	ASSERT_EQ(registry.Usage().slabs, usage.slabs);
+	auto expected = Expected(inputs[0]);
+	ASSERT_TRUE(std::equal(expected.begin(), expected.end(), registry.Lookup(again.value())));
+
+	registry.DestroyBatch(std::vector<Registry::ServiceId>{ids[0].value(), ids[1].value(), ids[2].value()}.data(), 3);
+	ASSERT_EQ(registry.Usage().services, 0);
+	ASSERT_EQ(registry.Usage().lookups, 0);
+}
+
+TEST(Registry, SetRealWeightFansOut)
+{
+	std::vector<UpdaterInput> inputs{UpdaterInput{},
+	                                 UpdaterInput{.reals = {"beta", "omega", "alpha"}, .ids = {7, 8, 9}, .weights = {50, 50, 50}},
+	                                 UpdaterInput{.reals = {"x", "y"}, .ids = {1, 2}, .weights = {50, 50}}};
+	Registry registry;
+	std::vector<Registry::ServiceId> ids;
+	std::vector<std::vector<RealId>> before;
+	for (auto& input : inputs)
+	{
+		input.lookup_size = chash::WeightUpdater::LookupRequiredSize(input.ids.size(), input.cells);
+		ids.push_back(registry.Create(Spec(input)).value());
+		before.push_back(Expected(input));
+	}
+	ASSERT_EQ(registry.Members("beta").size(), 2);
+	ASSERT_TRUE(registry.Members("nothing").empty());
+
+	auto dirty = registry.SetRealWeight("beta", 0, 2);
+	ASSERT_FALSE(dirty.empty());
+	for (std::size_t s = 0; s < inputs.size(); ++s)
+	{
+		auto updater = MakeUpdater(inputs[s]);
+		auto expected = before[s];
+		Weight zero = 0;
+		if (s < 2)
+		{
+			RealId id = s == 0 ? 2 : 7;
+			updater->UpdateLookup(&id, &zero, 1, expected.data());
+		}
+		const RealId* lookup = registry.Lookup(ids[s]);
+		ASSERT_TRUE(std::equal(expected.begin(), expected.end(), lookup));
+
+		// every changed cell is reported
+		std::vector<bool> reported(expected.size());
+		for (const auto& range : dirty)
+		{
+			if (range.service == ids[s])
+			{
+				std::fill_n(reported.begin() + range.start, range.count, true);
+			}
+		}
+		for (std::size_t i = 0; i < expected.size(); ++i)
+		{
+			ASSERT_TRUE(reported[i] || before[s][i] == lookup[i]);
+		}
+	}
+
+	registry.Destroy(ids[0]);
+	ASSERT_EQ(registry.Members("beta").size(), 1);
+	ASSERT_TRUE(registry.Members("gamma").empty());
+}
+
+// services share the updater pool, run under -Db_sanitize=thread to check
+// parallel updates
+TEST(Registry, ParallelUpdates)
+{
+	constexpr std::size_t SERVICES = 16;
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	std::vector<Registry::ServiceSpec> specs(SERVICES, Spec(input));
+	Registry registry;
+	std::vector<std::optional<Registry::ServiceId>> ids(SERVICES);
+	registry.CreateBatch(specs.data(), specs.size(), ids.data(), 4);
+
+	std::vector<std::vector<Weight>> weights;
+	std::vector<Registry::ServiceUpdate> updates;
+	for (std::size_t round = 0; round < 3; ++round)
+	{
+		for (std::size_t s = 0; s < SERVICES; ++s)
+		{
+			weights.push_back({Weight((s + round) % 101), Weight(s * 7 % 101), 0, Weight(100 - s)});
+		}
+	}
+	for (std::size_t k = 0; k < weights.size(); ++k)
+	{
+		updates.push_back({ids[k % SERVICES].value(), input.ids.data(), weights[k].data(), 4});
+	}
+	registry.UpdateBatch(updates.data(), updates.size(), 4);
+	registry.SetRealWeight("gamma", 30, 4);
+
+	for (std::size_t s = 0; s < SERVICES; ++s)
+	{
+		auto updater = MakeUpdater(input);
+		std::vector<RealId> expected(input.lookup_size);
+		updater->InitLookup(expected.data());
+		for (std::size_t k = s; k < weights.size(); k += SERVICES)
+		{
+			updater->UpdateLookup(input.ids.data(), weights[k].data(), 4, expected.data());
+		}
+		RealId gamma = 3;
+		Weight thirty = 30;
+		updater->UpdateLookup(&gamma, &thirty, 1, expected.data());
+		ASSERT_TRUE(std::equal(expected.begin(), expected.end(), registry.Lookup(ids[s].value())));
+	}
+}
+
+}
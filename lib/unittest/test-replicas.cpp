@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../replicas.hpp"
+
+namespace
+{
+
+using namespace test;
+
+TEST(Replicas, ChangesReproduceUpdate)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto updater = MakeUpdater(input);
+	ASSERT_TRUE(updater);
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+	auto copy = lookup;
+
+	std::pmr::vector<chash::WeightUpdater::Slice> changes;
+	for (const std::vector<Weight>& weights : {std::vector<Weight>{0, 0, 0, 0},
+	                                           std::vector<Weight>{3, 100, 0, 17},
+	                                           std::vector<Weight>{100, 100, 100, 100}})
+	{
+		changes.clear();
+		updater->UpdateLookup(input.ids.data(), weights.data(), weights.size(), lookup.data(), changes);
+		ASSERT_FALSE(changes.empty());
+		chash::WeightUpdater::ApplyChanges(changes.data(), changes.size(), copy.data());
+		ASSERT_EQ(copy, lookup);
+	}
+}
+
+TEST(Replicas, AllReplicasUpdated)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto updater = MakeUpdater(input);
+	auto reference = MakeUpdater(input);
+	ASSERT_TRUE(updater);
+	std::vector<RealId> expected(input.lookup_size);
+	reference->InitLookup(expected.data());
+
+	// node 1 << 20 does not exist, its writer runs unpinned
+	std::vector<std::vector<RealId>> copies(3, expected);
+	chash::LookupReplicas replicas({{copies[0].data(), 0}, {copies[1].data(), std::nullopt}, {copies[2].data(), 1 << 20}});
+
+	std::vector<Weight> weights = {0, 80, 20, 100};
+	for (std::size_t i = 0; i < weights.size(); ++i)
+	{
+		replicas.UpdateLookup(updater.value(), input.ids.data() + i, weights.data() + i, 1);
+		reference->UpdateLookup(input.ids.data() + i, weights.data() + i, 1, expected.data());
+		for (auto& copy : copies)
+		{
+			ASSERT_EQ(copy, expected);
+		}
+	}
+}
+
+}
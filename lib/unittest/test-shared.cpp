@@ -0,0 +1,146 @@
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../shared.hpp"
+
+namespace
+{
+
+using namespace test;
+
+std::vector<std::pair<RealId, Weight>> Changes()
+{
+	return {{1, 0}, {3, 100}, {4, 70}, {2, 0}, {1, 5}, {3, 0}};
+}
+
+TEST(Shared, ReattachAfterUpdates)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto reference = MakeUpdater(input);
+	auto updater = MakeUpdater(input);
+	ASSERT_TRUE(updater);
+	std::vector<RealId> expected(input.lookup_size);
+	reference->InitLookup(expected.data());
+
+	std::size_t size = chash::SharedUpdater::RequiredSize(updater.value());
+	std::vector<std::uint64_t> region(size / sizeof(std::uint64_t));
+	auto shared = chash::SharedUpdater::Create(std::move(updater.value()), region.data(), size);
+	ASSERT_TRUE(shared);
+	ASSERT_EQ(chash::SharedUpdater::LookupSize(region.data()), input.lookup_size);
+	ASSERT_TRUE(std::equal(expected.begin(), expected.end(), chash::SharedUpdater::Lookup(region.data())));
+
+	for (auto [id, weight] : Changes())
+	{
+		reference->UpdateWeight(id, weight, expected.data());
+		shared->UpdateWeight(id, weight);
+
+		auto attached = chash::SharedUpdater::Attach(region.data(), size);
+		ASSERT_TRUE(attached);
+		ASSERT_TRUE(std::equal(expected.begin(), expected.end(), attached->Lookup()));
+		std::vector<RealId> restored(input.lookup_size);
+		attached->Local().InitLookup(restored.data());
+		ASSERT_EQ(restored, expected) << "id: " << id;
+	}
+	ASSERT_EQ(shared->Generation(), Changes().size());
+}
+
+TEST(Shared, RepairsInterruptedUpdate)
+{
+	UpdaterInput input{};
+	auto updater = MakeUpdater(input);
+	ASSERT_TRUE(updater);
+	std::size_t size = chash::SharedUpdater::RequiredSize(updater.value());
+	std::vector<std::uint64_t> region(size / sizeof(std::uint64_t));
+	auto shared = chash::SharedUpdater::Create(std::move(updater.value()), region.data(), size);
+	ASSERT_TRUE(shared);
+	shared->UpdateWeight(2, 0);
+
+	std::vector<RealId> expected(shared->Lookup(), shared->Lookup() + input.lookup_size);
+	auto* header = reinterpret_cast<chash::SharedHeader*>(region.data());
+	header->updating = 1;
+	std::fill(shared->Lookup(), shared->Lookup() + input.lookup_size / 2, 1);
+
+	auto attached = chash::SharedUpdater::Attach(region.data(), size);
+	ASSERT_TRUE(attached);
+	ASSERT_EQ(header->updating, 0);
+	ASSERT_TRUE(std::equal(expected.begin(), expected.end(), attached->Lookup()));
+}
+
+TEST(Shared, MappedTwice)
+{
+	UpdaterInput input{};
+	auto updater = MakeUpdater(input);
+	ASSERT_TRUE(updater);
+	std::size_t size = chash::SharedUpdater::RequiredSize(updater.value());
+
+	int fd = memfd_create("chash-unittest", 0);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(ftruncate(fd, size), 0);
+	void* control = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	ASSERT_NE(control, MAP_FAILED);
+	ASSERT_NE(data, MAP_FAILED);
+
+	auto shared = chash::SharedUpdater::Create(std::move(updater.value()), control, size);
+	ASSERT_TRUE(shared);
+	shared->UpdateWeight(1, 0);
+	const RealId* lookup = chash::SharedUpdater::Lookup(data);
+	ASSERT_TRUE(std::equal(lookup, lookup + input.lookup_size, shared->Lookup()));
+	ASSERT_EQ(std::count(lookup, lookup + input.lookup_size, 1), 0);
+
+	munmap(data, size);
+	munmap(control, size);
+	close(fd);
+}
+
+TEST(Shared, RejectsDamaged)
+{
+	UpdaterInput input{};
+	auto updater = MakeUpdater(input);
+	ASSERT_TRUE(updater);
+	std::size_t size = chash::SharedUpdater::RequiredSize(updater.value());
+	std::vector<std::uint64_t> region(size / sizeof(std::uint64_t));
+	ASSERT_FALSE(chash::SharedUpdater::Create(std::move(updater.value()), region.data(), size - 8));
+	updater = MakeUpdater(input);
+	ASSERT_TRUE(chash::SharedUpdater::Create(std::move(updater.value()), region.data(), size));
+
+	region[sizeof(chash::SharedHeader) / sizeof(std::uint64_t) + 1] ^= 1;
+	ASSERT_FALSE(chash::SharedUpdater::Attach(region.data(), size));
+	ASSERT_FALSE(chash::SharedUpdater::Attach(region.data(), 16));
+}
+
+TEST(Shared, RejectsWrappingCounts)
+{
+	UpdaterInput input{};
+	auto updater = MakeUpdater(input);
+	ASSERT_TRUE(updater);
+	std::size_t size = chash::SharedUpdater::RequiredSize(updater.value());
+	std::vector<std::uint64_t> image(size / sizeof(std::uint64_t));
+	ASSERT_TRUE(chash::SharedUpdater::Create(std::move(updater.value()), image.data(), size));
+
+	// counts whose sizes in bytes wrap to the valid ones, with a valid crc
+	constexpr std::size_t CRC_START = offsetof(chash::SharedHeader, crc) + sizeof(std::uint32_t);
+	constexpr std::size_t CRC_END = offsetof(chash::SharedHeader, active);
+	std::pair<std::uint64_t chash::SharedHeader::*, std::uint64_t> counts[] = {
+	        {&chash::SharedHeader::real_count, std::uint64_t{1} << 61},
+	        {&chash::SharedHeader::heads_count, std::uint64_t{1} << 62}};
+	for (auto [count, wrap] : counts)
+	{
+		auto region = image;
+		auto* base = reinterpret_cast<std::uint8_t*>(region.data());
+		chash::SharedHeader header;
+		std::memcpy(&header, base, sizeof(header));
+		header.*count += wrap;
+		std::memcpy(base, &header, sizeof(header));
+		std::uint32_t crc = crc32_fast(base + CRC_START, CRC_END - CRC_START);
+		header.crc = crc32_fast(base + header.reals_offset, header.enabled_offset - header.reals_offset, crc);
+		std::memcpy(base, &header, sizeof(header));
+		ASSERT_FALSE(chash::SharedUpdater::Attach(region.data(), size));
+	}
+}
+
+}
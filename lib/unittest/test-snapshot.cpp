@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../snapshot.hpp"
+
+namespace
+{
+
+using namespace test;
+
+TEST(Snapshot, RoundTrip)
+{
+	UpdaterInput input{.weights = {100, 20, 0, 1}};
+	input.lookup_size = input.lookup_size * 3 / 2;
+	auto original = MakeUpdater(input);
+	ASSERT_TRUE(original);
+
+	auto image = chash::Snapshot::Serialize(original.value());
+	ASSERT_EQ(image.size(), chash::Snapshot::Size(original.value()));
+	auto restored = chash::Snapshot::Load(image.data(), image.size());
+	ASSERT_TRUE(restored);
+	ASSERT_EQ(restored->LookupSize(), original->LookupSize());
+	ASSERT_EQ(chash::Snapshot::Serialize(restored.value()), image);
+
+	std::vector<RealId> expected(input.lookup_size);
+	std::vector<RealId> lookup(input.lookup_size);
+	original->InitLookup(expected.data());
+	restored->InitLookup(lookup.data());
+	ASSERT_EQ(lookup, expected);
+
+	std::vector<std::pair<RealId, Weight>> changes = {{1, 0}, {3, 100}, {4, 70}, {2, 0}, {1, 5}};
+	for (auto [id, weight] : changes)
+	{
+		original->UpdateWeight(id, weight, expected.data());
+		restored->UpdateWeight(id, weight, lookup.data());
+		ASSERT_EQ(lookup, expected) << "id: " << id;
+	}
+}
+
+TEST(Snapshot, RejectsDamaged)
+{
+	UpdaterInput input{};
+	auto original = MakeUpdater(input);
+	ASSERT_TRUE(original);
+	auto image = chash::Snapshot::Serialize(original.value());
+
+	ASSERT_FALSE(chash::Snapshot::Load(image.data(), image.size() - 1));
+	ASSERT_FALSE(chash::Snapshot::Load(image.data(), sizeof(chash::SnapshotHeader) - 1));
+
+	for (std::size_t offset : {std::size_t{0}, std::size_t{16}, image.size() / 2, image.size() - 1})
+	{
+		auto damaged = image;
+		damaged[offset] ^= 0x10;
+		ASSERT_FALSE(chash::Snapshot::Load(damaged.data(), damaged.size())) << "offset: " << offset;
+	}
+}
+
+TEST(Snapshot, RejectsWrappingCounts)
+{
+	UpdaterInput input{};
+	auto original = MakeUpdater(input);
+	ASSERT_TRUE(original);
+	auto image = chash::Snapshot::Serialize(original.value());
+
+	// counts whose sizes in bytes wrap to the valid ones, with a valid crc
+	constexpr std::size_t CRC_START = offsetof(chash::SnapshotHeader, crc) + sizeof(std::uint32_t);
+	for (auto count : {&chash::SnapshotHeader::real_count, &chash::SnapshotHeader::heads_count})
+	{
+		auto crafted = image;
+		chash::SnapshotHeader header;
+		std::memcpy(&header, crafted.data(), sizeof(header));
+		header.*count += count == &chash::SnapshotHeader::real_count ? std::uint64_t{1} << 59 : std::uint64_t{1} << 62;
+		std::memcpy(crafted.data(), &header, sizeof(header));
+		header.crc = crc32_fast(crafted.data() + CRC_START, header.total_size - CRC_START);
+		std::memcpy(crafted.data(), &header, sizeof(header));
+		ASSERT_FALSE(chash::Snapshot::Load(crafted.data(), crafted.size()));
+	}
+}
+
+TEST(Snapshot, RejectsInconsistentState)
+{
+	UpdaterInput input{.weights = {100, 20, 0, 1}};
+	auto original = MakeUpdater(input);
+	ASSERT_TRUE(original);
+	auto image = chash::Snapshot::Serialize(original.value());
+	chash::SnapshotHeader header;
+	std::memcpy(&header, image.data(), sizeof(header));
+
+	// well formed images with a valid crc whose active count or bitmap
+	// disagree with the reals
+	constexpr std::size_t CRC_START = offsetof(chash::SnapshotHeader, crc) + sizeof(std::uint32_t);
+	auto reseal = [&](std::vector<std::uint8_t>& crafted) {
+		chash::SnapshotHeader changed;
+		std::memcpy(&changed, crafted.data(), sizeof(changed));
+		changed.crc = crc32_fast(crafted.data() + CRC_START, changed.total_size - CRC_START);
+		std::memcpy(crafted.data(), &changed, sizeof(changed));
+	};
+	for (std::uint64_t active : {header.active - 1, header.active + 1})
+	{
+		auto crafted = image;
+		std::memcpy(crafted.data() + offsetof(chash::SnapshotHeader, active), &active, sizeof(active));
+		reseal(crafted);
+		ASSERT_FALSE(chash::Snapshot::Load(crafted.data(), crafted.size())) << "active: " << active;
+	}
+	for (std::size_t word : {std::size_t{0}, (header.lookup_size - 1) / 64})
+	{
+		auto crafted = image;
+		crafted[header.bitmap_offset + word * sizeof(std::uint64_t)] ^= 0x01;
+		reseal(crafted);
+		ASSERT_FALSE(chash::Snapshot::Load(crafted.data(), crafted.size())) << "word: " << word;
+	}
+
+	auto resealed = image;
+	reseal(resealed);
+	ASSERT_TRUE(chash::Snapshot::Load(resealed.data(), resealed.size()));
+}
+
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../chash.hpp"
+
+namespace
+{
+
+using namespace test;
+
+struct StatsConfig : chash::DefaultConfig
+{
+	using Stats = chash::UpdaterStats;
+};
+
+using Updater = chash::BasicWeightUpdater<StatsConfig>;
+
+TEST(Stats, HistogramPercentiles)
+{
+	chash::Histogram h;
+	for (std::uint64_t v = 1; v <= 1000; ++v)
+	{
+		h.Add(v);
+	}
+	ASSERT_EQ(h.Total(), 1000);
+	ASSERT_EQ(h.Max(), 1000);
+	ASSERT_EQ(h.Percentile(0), 1);
+	for (double p : {0.5, 0.99, 0.999})
+	{
+		double exact = p * 1000;
+		ASSERT_LE(h.Percentile(p), exact);
+		ASSERT_GE(h.Percentile(p), exact * 15 / 16);
+	}
+}
+
+TEST(Stats, CountsUpdates)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto updater = Updater::MakeWeightUpdater(input.reals.data(),
+	                                          input.ids.data(),
+	                                          input.weights.data(),
+	                                          input.ids.size(),
+	                                          input.mappings,
+	                                          input.cells,
+	                                          input.lookup_size);
+	ASSERT_TRUE(updater);
+	const auto& stats = updater->Statistics();
+	ASSERT_EQ(stats.Of(chash::Operation::MAKE).Total(), 1);
+	ASSERT_GT(stats.rebalance_moves, 0);
+
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+	ASSERT_EQ(stats.Of(chash::Operation::INIT_LOOKUP).Total(), 1);
+
+	updater->UpdateWeight(1, 90, lookup.data());
+	ASSERT_EQ(stats.slices_disabled, 10 * input.cells);
+	updater->UpdateWeight(1, 100, lookup.data());
+	ASSERT_EQ(stats.slices_enabled, 10 * input.cells);
+	ASSERT_EQ(stats.Of(chash::Operation::UPDATE_WEIGHT).Total(), 2);
+	ASSERT_GT(stats.walk.Total(), 0);
+	ASSERT_GT(stats.cells_written, 0);
+
+	std::vector<Weight> weights = {0, 0, 0, 0};
+	updater->UpdateLookup(input.ids.data(), weights.data(), weights.size(), lookup.data());
+	ASSERT_EQ(stats.Of(chash::Operation::UPDATE_LOOKUP).Total(), 1);
+	ASSERT_EQ(stats.Of(chash::Operation::UPDATE_WEIGHT).Total(), 2);
+
+	updater->ResetStatistics();
+	ASSERT_EQ(stats.slices_disabled, 0);
+}
+
+}
@@ -0,0 +1,50 @@
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../storage.hpp"
+
+namespace
+{
+
+using namespace test;
+
+TEST(Storage, InitializesLookupInPlace)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto updater = MakeUpdater(input);
+	ASSERT_TRUE(updater);
+	std::vector<RealId> expected(input.lookup_size);
+	updater->InitLookup(expected.data());
+
+	for (bool hugepages : {true, false})
+	{
+		auto storage = chash::MakeLookupStorage(updater.value(), {.hugepages = hugepages, .lock = true, .node = 0});
+		ASSERT_TRUE(storage);
+		ASSERT_EQ(reinterpret_cast<std::uintptr_t>(storage->Data()) % chash::LookupStorage::HUGE_PAGE, 0);
+		ASSERT_EQ(storage->Size(), input.lookup_size * sizeof(RealId));
+		ASSERT_GE(storage->Mapped(), storage->Size());
+		ASSERT_EQ(storage->Mapped() % chash::LookupStorage::HUGE_PAGE, 0);
+		if (!hugepages)
+		{
+			ASSERT_FALSE(storage->HugeTlb());
+		}
+		const RealId* lookup = storage->As<RealId>();
+		ASSERT_TRUE(std::equal(expected.begin(), expected.end(), lookup));
+	}
+}
+
+TEST(Storage, InvalidNodeIsNotFatal)
+{
+	auto storage = chash::LookupStorage::Allocate(1000, {.node = 1 << 20});
+	ASSERT_TRUE(storage);
+	ASSERT_FALSE(storage->Bound());
+
+	auto moved = std::move(storage.value());
+	ASSERT_EQ(storage->Data(), nullptr);
+	moved.As<char>()[999] = 1;
+}
+
+}
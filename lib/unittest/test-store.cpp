@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include "common.h"
+
+#include "../store.hpp"
+
+namespace
+{
+
+using namespace test;
+
+using Store = chash::LookupStore;
+
+std::uint64_t Input(const UpdaterInput& input)
+{
+	return Store::InputFingerprint(input.reals.data(),
+	                               input.ids.data(),
+	                               input.weights.data(),
+	                               input.ids.size(),
+	                               input.mappings,
+	                               input.cells,
+	                               input.lookup_size);
+}
+
+Store::Lookup Acquire(Store& store, const chash::WeightUpdater& updater, const UpdaterInput& input, std::uint64_t fingerprint)
+{
+	return store.Acquire(updater,
+	                     fingerprint,
+	                     input.reals.data(),
+	                     input.ids.data(),
+	                     input.weights.data(),
+	                     input.ids.size(),
+	                     input.mappings,
+	                     input.cells);
+}
+
+TEST(Store, SharesUntilDiverged)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto first = MakeUpdater(input);
+	auto second = MakeUpdater(input);
+	auto reference = MakeUpdater(input);
+	std::vector<RealId> expected(input.lookup_size);
+	reference->InitLookup(expected.data());
+
+	Store store;
+	auto a = Acquire(store, first.value(), input, Input(input));
+	auto b = Acquire(store, second.value(), input, Input(input));
+	ASSERT_EQ(a.Data(), b.Data());
+	ASSERT_TRUE(a.Shared());
+	ASSERT_TRUE(std::equal(expected.begin(), expected.end(), a.Data()));
+	ASSERT_EQ(store.Statistics().tables, 1);
+
+	std::vector<Weight> weights = {0, 100, 30, 7};
+	reference->UpdateLookup(input.ids.data(), weights.data(), weights.size(), expected.data());
+	store.Update(a, first.value(), input.ids.data(), weights.data(), weights.size());
+	ASSERT_NE(a.Data(), b.Data());
+	ASSERT_FALSE(a.Shared());
+	ASSERT_TRUE(std::equal(expected.begin(), expected.end(), a.Data()));
+	ASSERT_EQ(a.ContentHash(), Store::ContentHash(expected.data(), expected.size()));
+	ASSERT_EQ(store.Statistics().tables, 2);
+
+	// private table is updated in place
+	const RealId* data = a.Data();
+	std::vector<Weight> disable = {0, 0, 0, 0};
+	reference->UpdateLookup(input.ids.data(), disable.data(), disable.size(), expected.data());
+	store.Update(a, first.value(), input.ids.data(), disable.data(), disable.size());
+	ASSERT_EQ(a.Data(), data);
+	ASSERT_TRUE(std::equal(expected.begin(), expected.end(), a.Data()));
+	ASSERT_EQ(a.ContentHash(), Store::ContentHash(expected.data(), expected.size()));
+
+	// same updates make tables equal and shared again
+	store.Update(b, second.value(), input.ids.data(), weights.data(), weights.size());
+	store.Update(b, second.value(), input.ids.data(), disable.data(), disable.size());
+	ASSERT_EQ(a.Data(), b.Data());
+	ASSERT_EQ(store.Statistics().tables, 1);
+	ASSERT_EQ(store.Statistics().referenced_bytes, 2 * input.lookup_size * sizeof(RealId));
+
+	// input of updated tables is not reused
+	auto c = Acquire(store, MakeUpdater(input).value(), input, Input(input));
+	ASSERT_NE(c.Data(), a.Data());
+}
+
+TEST(Store, FingerprintCollision)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	UpdaterInput other{.weights = {1, 50, 20, 100}};
+	auto first = MakeUpdater(input);
+	auto second = MakeUpdater(other);
+	std::vector<RealId> expected(other.lookup_size);
+	second->InitLookup(expected.data());
+
+	// inputs differ but are given the same fingerprint
+	Store store;
+	auto a = Acquire(store, first.value(), input, Input(input));
+	auto b = Acquire(store, second.value(), other, Input(input));
+	ASSERT_NE(a.Data(), b.Data());
+	ASSERT_TRUE(std::equal(expected.begin(), expected.end(), b.Data()));
+}
+
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "common.h"
+
+#include "../chash.hpp"
+
+namespace
+{
+
+using namespace test;
+
+TEST(Transaction, RollbackRestoresLookup)
+{
+	UpdaterInput input{.weights = {100, 20, 50, 1}};
+	auto updater = MakeUpdater(input);
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+	auto reference = *updater;
+
+	std::mt19937 gen(3);
+	for (int round = 0; round < 20; ++round)
+	{
+		std::vector<RealId> before = lookup;
+		updater->Begin();
+		for (int step = 0; step < 10; ++step)
+		{
+			std::vector<Weight> weights(input.ids.size());
+			for (auto& weight : weights)
+			{
+				weight = gen() % 4 == 0 ? 0 : gen() % 101;
+			}
+			updater->UpdateLookup(input.ids.data(), weights.data(), weights.size(), lookup.data());
+			updater->UpdateWeight(gen() % 4 + 1, gen() % 101, lookup.data());
+		}
+		updater->Rollback(lookup.data());
+		ASSERT_FALSE(updater->InTransaction());
+		ASSERT_EQ(lookup, before);
+
+		// both go on the same way
+		std::vector<Weight> weights = {Weight(gen() % 101), 0, Weight(gen() % 101), 100};
+		std::vector<RealId> expected = lookup;
+		reference.UpdateLookup(input.ids.data(), weights.data(), weights.size(), expected.data());
+		updater->UpdateLookup(input.ids.data(), weights.data(), weights.size(), lookup.data());
+		ASSERT_EQ(lookup, expected);
+	}
+}
+
+TEST(Transaction, CommitKeepsChanges)
+{
+	UpdaterInput input;
+	auto updater = MakeUpdater(input);
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+
+	updater->Begin();
+	updater->UpdateWeight(1, 0, lookup.data());
+	updater->Commit();
+	std::vector<RealId> committed = lookup;
+	updater->Rollback(lookup.data());
+	ASSERT_EQ(lookup, committed);
+	ASSERT_EQ(std::count(lookup.begin(), lookup.end(), 1), 0);
+}
+
+TEST(Transaction, RollbackAfterDrain)
+{
+	UpdaterInput input;
+	auto updater = MakeUpdater(input);
+	std::vector<RealId> lookup(input.lookup_size);
+	updater->InitLookup(lookup.data());
+	std::vector<RealId> before = lookup;
+	auto copy = lookup;
+
+	std::vector<Weight> zeros(input.ids.size(), 0);
+	std::pmr::vector<chash::WeightUpdater::Slice> changes;
+	updater->Begin();
+	updater->UpdateLookup(input.ids.data(), zeros.data(), zeros.size(), lookup.data(), changes);
+	ASSERT_TRUE(updater->Disabled());
+	updater->Rollback(lookup.data(), changes);
+	ASSERT_FALSE(updater->Disabled());
+	ASSERT_EQ(lookup, before);
+
+	// a replica follows the update and the rollback
+	chash::WeightUpdater::ApplyChanges(changes.data(), changes.size(), copy.data());
+	ASSERT_EQ(copy, before);
+}
+
+} // namespace
@@ -1,9 +1,10 @@
 #pragma once
 
 #include <algorithm>
-#include <map>
+#include <memory_resource>
 #include <optional>
 #include <random>
+#include <unordered_set>
 #include <vector>
 
 #include "hash.hpp"
@@ -14,82 +15,101 @@ namespace chash
 template<typename RealId>
 class Unweighted
 {
-	std::vector<RealId> lookup_;
+	std::pmr::vector<RealId> lookup_;
 
+public:
+	/* @brief Cell in the ring the real hashes to and index of the real in
+	 * input. Sorting these gives the guide of a ring without a map.
+	 */
+	using Candidates = std::pmr::vector<std::pair<IdHash, std::size_t>>;
+
+	explicit Unweighted(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+	        lookup_(resource)
+	{
+	}
+
+	/* @brief Rebuilds ring in place with \size cells, reusing memory of the
+	 * previous ring and of \candidates. Returns number of reals that made it
+	 * into the ring, their input indices are second members of the first
+	 * that many \candidates.
+	 */
 	template<typename Real>
-	static std::map<IdHash, RealId> Temporary(
+	std::size_t Assign(
 	        const Real* reals,
 	        const RealId* ids,
 	        std::size_t cnt,
 	        Salt salt,
-			std::size_t size)
+	        std::size_t size,
+	        Candidates& candidates)
 	{
-		std::map<IdHash, RealId> to_id;
-		std::map<IdHash, std::size_t> seen;
+		candidates.clear();
 		for (std::size_t i = 0; i < cnt; ++i)
 		{
-			const Real& real = reals[i];
-			const RealId& id = ids[i];
-			auto hid = CalcHash(real, salt) % size;
-			// Real comparing greater wins collision
-			if (auto it = to_id.find(hid); it != to_id.end())
+			candidates.emplace_back(CalcHash(reals[i], salt) % size, i);
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		// Real comparing greater wins collision, the earliest one among equal
+		std::size_t guide = 0;
+		for (std::size_t i = 0; i < candidates.size();)
+		{
+			std::size_t winner = candidates[i].second;
+			std::size_t j = i + 1;
+			for (; j < candidates.size() && candidates[j].first == candidates[i].first; ++j)
 			{
-				auto& real_old = reals[seen.at(hid)];
-				if (real_old < real)
+				if (reals[winner] < reals[candidates[j].second])
 				{
-					to_id[hid] = id;
-					seen[hid] = i;
+					winner = candidates[j].second;
 				}
 			}
-			else
-			{
-				to_id[hid] = id;
-				seen[hid] = i;
-			}
+			candidates[guide++] = {candidates[i].first, winner};
+			i = j;
 		}
-		return to_id;
-	}
 
-	std::unordered_set<RealId> InitLookup(const std::map<IdHash, RealId>& guide, std::size_t size)
-	{
-		RealId tint = std::prev(guide.end())->second;
-		std::unordered_set<RealId> result;
-		result.insert(tint);
-		auto next = guide.begin();
-		for (std::size_t i = 0; i < size; ++i)
+		lookup_.clear();
+		if (guide == 0)
 		{
-			if ((next != guide.end()) && (next->first == i))
-			{
-				tint = next->second;
-				result.insert(tint);
-				++next;
-			}
-			lookup_.push_back(tint);
+			return 0;
 		}
-		return result;
-	}
-
-	Unweighted(std::size_t size)
-	{
-		lookup_.reserve(size);
+		RealId tint = ids[candidates[guide - 1].second];
+		std::size_t from = 0;
+		for (std::size_t k = 0; k < guide; ++k)
+		{
+			lookup_.insert(lookup_.end(), candidates[k].first - from, tint);
+			tint = ids[candidates[k].second];
+			from = candidates[k].first;
+		}
+		lookup_.insert(lookup_.end(), size - from, tint);
+		return guide;
 	}
 
-public:
+	/* @brief Builds ring of \size cells and returns it along with the set of
+	 * ids that made it into the ring. All memory, including temporaries, is
+	 * taken from \resource.
+	 */
 	template<typename Real>
-	static std::pair<Unweighted, std::unordered_set<RealId>> Make(
+	static std::pair<Unweighted, std::pmr::unordered_set<RealId>> Make(
 	        const Real* reals,
 	        const RealId* ids,
 	        std::size_t cnt,
 	        Salt salt,
-	        std::size_t size)
+	        std::size_t size,
+	        std::pmr::memory_resource* resource = std::pmr::get_default_resource())
 	{
-		std::map<IdHash, RealId> mapping = Temporary(reals, ids, cnt, salt, size);
-		Unweighted ring(size);
+		Unweighted ring(resource);
+		ring.lookup_.reserve(size);
+		Candidates candidates(resource);
+		std::size_t guide = ring.Assign(reals, ids, cnt, salt, size, candidates);
 
-		return std::pair<Unweighted, std::unordered_set<RealId>>{ ring, ring.InitLookup(mapping, size) };
+		std::pmr::unordered_set<RealId> contain(resource);
+		for (std::size_t k = 0; k < guide; ++k)
+		{
+			contain.insert(ids[candidates[k].second]);
+		}
+		return std::pair<Unweighted, std::pmr::unordered_set<RealId>>{std::move(ring), std::move(contain)};
 	}
 
-	RealId Match(IdHash hash)
+	RealId Match(IdHash hash) const
 	{
 		return lookup_[hash % lookup_.size()];
 	}
@@ -31,4 +31,81 @@ std::uint8_t PowerOfTwoLowerBound(std::size_t x)
 	return p;
 }
 
+
+WorkerPool::WorkerPool(std::size_t threads)
+{
+	threads = std::max<std::size_t>(threads, 1);
+	workers_.reserve(threads - 1);
+	for (std::size_t worker = 1; worker < threads; ++worker)
+	{
+		workers_.emplace_back(&WorkerPool::Work, this, worker);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (auto& worker : workers_)
+	{
+		worker.join();
+	}
+}
+
+void WorkerPool::Run(std::size_t count, Call call, void* f)
+{
+	std::size_t threads = std::max<std::size_t>(std::min(Threads(), count), 1);
+	std::size_t chunk = (count + threads - 1) / threads;
+	if (threads == 1)
+	{
+		call(f, 0, count);
+		return;
+	}
+	{
+		std::lock_guard lock(mutex_);
+		call_ = call;
+		f_ = f;
+		count_ = count;
+		chunk_ = chunk;
+		running_ = workers_.size();
+		++generation_;
+	}
+	wake_.notify_all();
+	call(f, 0, chunk);
+	std::unique_lock lock(mutex_);
+	done_.wait(lock, [&] { return running_ == 0; });
+}
+
+void WorkerPool::Work(std::size_t worker)
+{
+	std::uint64_t seen{};
+	std::unique_lock lock(mutex_);
+	while (true)
+	{
+		wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+		if (stop_)
+		{
+			return;
+		}
+		seen = generation_;
+		std::size_t begin = std::min(worker * chunk_, count_);
+		std::size_t end = std::min(begin + chunk_, count_);
+		Call call = call_;
+		void* f = f_;
+		lock.unlock();
+		if (begin != end)
+		{
+			call(f, begin, end);
+		}
+		lock.lock();
+		if (--running_ == 0)
+		{
+			done_.notify_one();
+		}
+	}
+}
+
 } // namespace chash
@@ -1,5 +1,11 @@
 #pragma once
+#include <algorithm>
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace chash
 {
@@ -14,9 +20,151 @@ std::size_t PrevRingPosition(std::size_t ring_size, std::size_t pos);
 template<std::size_t RingSize>
 std::size_t NextRingPosition(std::size_t pos)
 {
-	return (RingSize + pos + 1) % RingSize;
+	if constexpr ((RingSize & (RingSize - 1)) == 0)
+	{
+		return (pos + 1) & (RingSize - 1);
+	}
+	else
+	{
+		return (pos + 1 == RingSize) ? 0 : pos + 1;
+	}
 }
 
+template<std::size_t RingSize>
+std::size_t PrevRingPosition(std::size_t pos)
+{
+	if constexpr ((RingSize & (RingSize - 1)) == 0)
+	{
+		return (pos - 1) & (RingSize - 1);
+	}
+	else
+	{
+		return (pos == 0) ? RingSize - 1 : pos - 1;
+	}
+}
+
+/* @brief Ring which size is known at run time only.
+ */
+class DynamicRing
+{
+	std::size_t size_;
+
+public:
+	explicit DynamicRing(std::size_t size) :
+	        size_{size}
+	{
+	}
+
+	std::size_t Size() const
+	{
+		return size_;
+	}
+
+	std::size_t Next(std::size_t pos) const
+	{
+		return NextRingPosition(size_, pos);
+	}
+
+	std::size_t Prev(std::size_t pos) const
+	{
+		return PrevRingPosition(size_, pos);
+	}
+};
+
+/* @brief Ring of compile time size, wraps around with mask arithmetic for
+ * powers of two.
+ */
+template<std::size_t RingSize>
+struct StaticRing
+{
+	static constexpr std::size_t Size()
+	{
+		return RingSize;
+	}
+
+	static std::size_t Next(std::size_t pos)
+	{
+		return NextRingPosition<RingSize>(pos);
+	}
+
+	static std::size_t Prev(std::size_t pos)
+	{
+		return PrevRingPosition<RingSize>(pos);
+	}
+};
+
 std::uint8_t PowerOfTwoLowerBound(std::size_t x);
 
+/* @brief Splits [0, count) into at most \threads contiguous ranges and calls
+ * \f(begin, end) for each of them on its own thread. The calling thread takes
+ * the first range.
+ */
+template<typename F>
+void ParallelFor(std::size_t threads, std::size_t count, F&& f)
+{
+	threads = std::max<std::size_t>(std::min(threads, count), 1);
+	std::size_t chunk = (count + threads - 1) / threads;
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (std::size_t begin = chunk; begin < count; begin += chunk)
+	{
+		workers.emplace_back(f, begin, std::min(begin + chunk, count));
+	}
+	f(std::size_t{0}, std::min(chunk, count));
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+
+/* @brief Threads kept alive between calls of Run, for work made of many
+ * short parallel sections where starting threads for each would dominate.
+ * Run splits [0, count) into contiguous ranges like ParallelFor, the calling
+ * thread takes the first one. Run must not be called concurrently.
+ */
+class WorkerPool
+{
+	using Call = void (*)(void* f, std::size_t begin, std::size_t end);
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::condition_variable done_;
+	// current section, workers pick it up when generation_ changes
+	Call call_{};
+	void* f_{};
+	std::size_t count_{};
+	std::size_t chunk_{};
+	std::uint64_t generation_{};
+	std::size_t running_{};
+	bool stop_{};
+	std::vector<std::thread> workers_;
+
+public:
+	// \threads counts the calling thread
+	explicit WorkerPool(std::size_t threads);
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+	~WorkerPool();
+
+	std::size_t Threads() const
+	{
+		return workers_.size() + 1;
+	}
+
+	template<typename F>
+	void Run(std::size_t count, F&& f)
+	{
+		Run(count,
+		    [](void* f, std::size_t begin, std::size_t end) {
+			    (*static_cast<std::remove_reference_t<F>*>(f))(begin, end);
+		    },
+		    &f);
+	}
+
+private:
+	void Run(std::size_t count, Call call, void* f);
+	void Work(std::size_t worker);
+};
+
 } // namespace chash